@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-w workers[,workers...]] [-n size] [-r repetitions]\n", program);
+}
+
+int bench_parse_options(int argc, char **argv, size_t default_size, bench_options_t *options) {
+    options->workers[0] = 1;
+    options->workers[1] = 2;
+    options->workers[2] = 4;
+    options->nworkers = 3;
+    options->size = default_size;
+    options->repetitions = 3;
+
+    int option;
+    while ((option = getopt(argc, argv, "w:n:r:")) != -1) {
+        char *end;
+
+        switch (option) {
+            case 'w':
+                options->nworkers = 0;
+                for (char *token = strtok(optarg, ","); token != NULL; token = strtok(NULL, ",")) {
+                    if (options->nworkers == BENCH_MAX_CONFIGS)
+                        break;
+
+                    size_t workers = strtoul(token, &end, 10);
+                    if (*end != '\0' || workers == 0) {
+                        usage(argv[0]);
+                        return -1;
+                    }
+                    options->workers[options->nworkers++] = workers;
+                }
+                break;
+            case 'n':
+                options->size = strtoul(optarg, &end, 10);
+                if (*end != '\0' || options->size == 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'r':
+                options->repetitions = strtoul(optarg, &end, 10);
+                if (*end != '\0' || options->repetitions == 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (options->nworkers == 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    return 0;
+}
+
+unsigned long long bench_now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+void bench_run_system(size_t workers, role_t *role) {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = workers;
+
+    actor_system_t *system;
+    actor_id_t first_actor;
+    if (actor_system_start(&system, &first_actor, role, &config) != 0) {
+        fprintf(stderr, "Cannot create actor system\n");
+        exit(1);
+    }
+
+    actor_system_wait(system);
+}
+
+void bench_report(const char *name, size_t workers, size_t size, unsigned long long messages,
+                  unsigned long long elapsed_ns, const char *latency_of,
+                  const histogram_t *latency, const char *extra) {
+    double seconds = (double)elapsed_ns / 1e9;
+
+    printf("{\"benchmark\":\"%s\",\"workers\":%zu,\"size\":%zu,\"messages\":%llu,"
+           "\"seconds\":%.6f,\"msgs_per_sec\":%.1f,\"latency_of\":\"%s\",\"samples\":%llu,"
+           "\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu%s%s}\n",
+           name, workers, size, messages, seconds, seconds > 0 ? (double)messages / seconds : 0.0,
+           latency_of, histogram_count(latency), histogram_percentile(latency, 50),
+           histogram_percentile(latency, 99), histogram_max(latency),
+           extra != NULL ? "," : "", extra != NULL ? extra : "");
+    fflush(stdout);
+}
@@ -0,0 +1,33 @@
+#ifndef CACTI_BENCH_H
+#define CACTI_BENCH_H
+
+#include <stddef.h>
+
+#include "cacti.h"
+#include "histogram.h"
+
+#define BENCH_MAX_CONFIGS 16
+
+typedef struct bench_options {
+    size_t workers[BENCH_MAX_CONFIGS];  // Numbers of worker threads to run with.
+    size_t nworkers;
+    size_t size;                        // Meaning depends on the benchmark.
+    size_t repetitions;
+} bench_options_t;
+
+// Parses "-w 1,2,4 -n size -r repetitions". Prints usage and returns -1 on errors.
+int bench_parse_options(int argc, char **argv, size_t default_size, bench_options_t *options);
+
+unsigned long long bench_now_ns();
+
+// Starts a system with [workers] threads and first actor of [role], and waits until all its
+// actors die.
+void bench_run_system(size_t workers, role_t *role);
+
+// Prints results of one run as a line of JSON. [latency_of] tells what [latency] measures.
+// [extra] is appended to the object's fields if not NULL.
+void bench_report(const char *name, size_t workers, size_t size, unsigned long long messages,
+                  unsigned long long elapsed_ns, const char *latency_of,
+                  const histogram_t *latency, const char *extra);
+
+#endif //CACTI_BENCH_H
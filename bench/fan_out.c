@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+// Root multicasts a request to all its children in every round and waits for all replies
+// before starting the next one. Latency is the time from the multicast to each reply.
+
+#define FAN_OUT_ROUNDS 1000
+#define FAN_OUT_MAX_CHILDREN 512
+
+#define MSG_READY 1
+#define MSG_REPLY 2
+#define MSG_REQUEST 1
+
+static size_t nchildren;
+static size_t ready;
+static size_t replies;
+static size_t rounds;
+static actor_id_t children[FAN_OUT_MAX_CHILDREN];
+static histogram_t latency;
+
+static void child_hello(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    *stateptr = data;
+
+    actor_id_t self = actor_id_self();
+    send_message_inline((actor_id_t)data, MSG_READY, &self, sizeof(actor_id_t));
+}
+
+static void child_request(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    send_message((actor_id_t)*stateptr, (message_t){.message_type = MSG_REPLY, .nbytes = 0,
+                                                    .data = data});
+}
+
+static act_t child_prompts[] = {child_hello, child_request};
+static role_t child_role = {.nprompts = 2, .prompts = child_prompts};
+
+static void multicast(message_t message) {
+    if (send_message_multicast(children, nchildren, message, NULL) != 0)
+        exit(1);
+}
+
+static void root_hello(__attribute__((unused))void **stateptr,
+                       __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    for (size_t i = 0; i < nchildren; ++i)
+        send_message(actor_id_self(), (message_t){.message_type = MSG_SPAWN,
+                                                  .nbytes = sizeof(role_t), .data = &child_role});
+}
+
+static void root_ready(__attribute__((unused))void **stateptr,
+                       __attribute__((unused))size_t nbytes, void *data) {
+    children[ready++] = *(actor_id_t *)data;
+
+    if (ready == nchildren)
+        multicast((message_t){.message_type = MSG_REQUEST, .nbytes = 0,
+                              .data = (void *)(uintptr_t)bench_now_ns()});
+}
+
+static void root_reply(__attribute__((unused))void **stateptr,
+                       __attribute__((unused))size_t nbytes, void *data) {
+    histogram_record(&latency, bench_now_ns() - (unsigned long long)(uintptr_t)data);
+
+    if (++replies < nchildren)
+        return;
+
+    replies = 0;
+    if (++rounds < FAN_OUT_ROUNDS) {
+        multicast((message_t){.message_type = MSG_REQUEST, .nbytes = 0,
+                              .data = (void *)(uintptr_t)bench_now_ns()});
+        return;
+    }
+
+    multicast((message_t){.message_type = MSG_GODIE, .nbytes = 0, .data = NULL});
+    send_message(actor_id_self(), (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                              .data = NULL});
+}
+
+static act_t root_prompts[] = {root_hello, root_ready, root_reply};
+static role_t root_role = {.nprompts = 3, .prompts = root_prompts};
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    if (bench_parse_options(argc, argv, 64, &options) != 0)
+        return 1;
+
+    if (options.size > FAN_OUT_MAX_CHILDREN)
+        options.size = FAN_OUT_MAX_CHILDREN;
+
+    for (size_t i = 0; i < options.nworkers; ++i) {
+        for (size_t r = 0; r < options.repetitions; ++r) {
+            nchildren = options.size;
+            ready = 0;
+            replies = 0;
+            rounds = 0;
+            create_histogram(&latency);
+
+            unsigned long long start = bench_now_ns();
+            bench_run_system(options.workers[i], &root_role);
+
+            bench_report("fan_out", options.workers[i], options.size,
+                         2ULL * nchildren * FAN_OUT_ROUNDS, bench_now_ns() - start,
+                         "request_to_reply", &latency, NULL);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+// Two actors send a message back and forth, latency is the round trip time.
+
+#define MSG_READY 1
+#define MSG_PONG 2
+#define MSG_PING 1
+
+static size_t exchanges;
+static size_t done;
+static actor_id_t ponger;
+static histogram_t latency;
+
+static void send_ping() {
+    send_message(ponger, (message_t){.message_type = MSG_PING, .nbytes = 0,
+                                     .data = (void *)(uintptr_t)bench_now_ns()});
+}
+
+static void ponger_hello(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    *stateptr = data;
+
+    actor_id_t self = actor_id_self();
+    send_message_inline((actor_id_t)data, MSG_READY, &self, sizeof(actor_id_t));
+}
+
+static void ponger_ping(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    send_message((actor_id_t)*stateptr, (message_t){.message_type = MSG_PONG, .nbytes = 0,
+                                                    .data = data});
+}
+
+static act_t ponger_prompts[] = {ponger_hello, ponger_ping};
+static role_t ponger_role = {.nprompts = 2, .prompts = ponger_prompts};
+
+static void pinger_hello(__attribute__((unused))void **stateptr,
+                         __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    send_message(actor_id_self(), (message_t){.message_type = MSG_SPAWN,
+                                              .nbytes = sizeof(role_t), .data = &ponger_role});
+}
+
+static void pinger_ready(__attribute__((unused))void **stateptr,
+                         __attribute__((unused))size_t nbytes, void *data) {
+    ponger = *(actor_id_t *)data;
+    send_ping();
+}
+
+static void pinger_pong(__attribute__((unused))void **stateptr,
+                        __attribute__((unused))size_t nbytes, void *data) {
+    histogram_record(&latency, bench_now_ns() - (unsigned long long)(uintptr_t)data);
+
+    if (++done < exchanges) {
+        send_ping();
+        return;
+    }
+
+    send_message(ponger, (message_t){.message_type = MSG_GODIE, .nbytes = 0, .data = NULL});
+    send_message(actor_id_self(), (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                              .data = NULL});
+}
+
+static act_t pinger_prompts[] = {pinger_hello, pinger_ready, pinger_pong};
+static role_t pinger_role = {.nprompts = 3, .prompts = pinger_prompts};
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    if (bench_parse_options(argc, argv, 100000, &options) != 0)
+        return 1;
+
+    for (size_t i = 0; i < options.nworkers; ++i) {
+        for (size_t r = 0; r < options.repetitions; ++r) {
+            exchanges = options.size;
+            done = 0;
+            create_histogram(&latency);
+
+            unsigned long long start = bench_now_ns();
+            bench_run_system(options.workers[i], &pinger_role);
+
+            bench_report("ping_pong", options.workers[i], options.size, 2 * exchanges,
+                         bench_now_ns() - start, "round_trip", &latency, NULL);
+        }
+    }
+
+    return 0;
+}
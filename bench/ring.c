@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+// A token goes around a ring of actors. Latency is the time of one lap.
+
+#define RING_LAPS 1000
+
+#define MSG_LINK 1
+#define MSG_TOKEN 2
+#define MSG_STOP 3
+
+static size_t ring_size;
+static size_t created;
+static size_t laps;
+static unsigned long long lap_start;
+static actor_id_t ring_root;
+static histogram_t latency;
+
+static role_t member_role;
+
+static void send_next(void **stateptr, message_type_t message_type) {
+    send_message((actor_id_t)*stateptr, (message_t){.message_type = message_type, .nbytes = 0,
+                                                    .data = NULL});
+}
+
+static void member_hello(void **stateptr, size_t nbytes, void *data) {
+    actor_id_t self = actor_id_self();
+
+    // The first actor is created without a parent.
+    if (nbytes == 0) {
+        ring_root = self;
+        created = 1;
+    }
+    else {
+        send_message_inline((actor_id_t)data, MSG_LINK, &self, sizeof(actor_id_t));
+        ++created;
+    }
+
+    if (created < ring_size) {
+        send_message(self, (message_t){.message_type = MSG_SPAWN, .nbytes = sizeof(role_t),
+                                       .data = &member_role});
+        return;
+    }
+
+    // The last actor closes the ring and starts the token.
+    *stateptr = (void *)ring_root;
+    send_next(stateptr, MSG_TOKEN);
+}
+
+static void member_link(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    *stateptr = (void *)*(actor_id_t *)data;
+}
+
+static void member_token(void **stateptr, __attribute__((unused))size_t nbytes,
+                         __attribute__((unused))void *data) {
+    if (actor_id_self() == ring_root) {
+        unsigned long long now = bench_now_ns();
+
+        if (lap_start != 0) {
+            histogram_record(&latency, now - lap_start);
+
+            if (++laps == RING_LAPS) {
+                send_next(stateptr, MSG_STOP);
+                return;
+            }
+        }
+
+        lap_start = now;
+    }
+
+    send_next(stateptr, MSG_TOKEN);
+}
+
+static void member_stop(void **stateptr, __attribute__((unused))size_t nbytes,
+                        __attribute__((unused))void *data) {
+    if (actor_id_self() != ring_root)
+        send_next(stateptr, MSG_STOP);
+
+    send_message(actor_id_self(), (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                              .data = NULL});
+}
+
+static act_t member_prompts[] = {member_hello, member_link, member_token, member_stop};
+static role_t member_role = {.nprompts = 4, .prompts = member_prompts};
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    if (bench_parse_options(argc, argv, 100, &options) != 0)
+        return 1;
+
+    if (options.size < 2)
+        options.size = 2;
+
+    for (size_t i = 0; i < options.nworkers; ++i) {
+        for (size_t r = 0; r < options.repetitions; ++r) {
+            ring_size = options.size;
+            created = 0;
+            laps = 0;
+            lap_start = 0;
+            create_histogram(&latency);
+
+            unsigned long long start = bench_now_ns();
+            bench_run_system(options.workers[i], &member_role);
+
+            bench_report("ring", options.workers[i], options.size,
+                         (unsigned long long)ring_size * RING_LAPS, bench_now_ns() - start,
+                         "lap", &latency, NULL);
+        }
+    }
+
+    return 0;
+}
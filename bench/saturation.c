@@ -0,0 +1,121 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+// Producers send to one consumer as fast as its mailbox admits, keeping it at
+// ACTOR_QUEUE_LIMIT. Rejected sends are retried. Latency is the time a message waits.
+
+#define SATURATION_PRODUCERS 4
+#define SATURATION_BURST 256
+
+#define MSG_MESSAGE 1
+#define MSG_PRODUCE 1
+
+static size_t total;
+static size_t received;
+static atomic_ullong rejected;
+static histogram_t latency;
+
+typedef struct producer {
+    actor_id_t consumer;
+    size_t left;
+} producer_t;
+
+static void producer_produce(void **stateptr, __attribute__((unused))size_t nbytes,
+                             __attribute__((unused))void *data);
+
+static void producer_hello(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    producer_t *producer = malloc(sizeof(producer_t));
+    if (producer == NULL)
+        exit(1);
+
+    producer->consumer = (actor_id_t)data;
+    producer->left = total / SATURATION_PRODUCERS;
+    *stateptr = producer;
+
+    producer_produce(stateptr, 0, NULL);
+}
+
+static void producer_produce(void **stateptr, __attribute__((unused))size_t nbytes,
+                             __attribute__((unused))void *data) {
+    producer_t *producer = *stateptr;
+
+    for (size_t i = 0; i < SATURATION_BURST && producer->left > 0; ++i) {
+        int result = send_message(producer->consumer, (message_t){
+                .message_type = MSG_MESSAGE, .nbytes = 0,
+                .data = (void *)(uintptr_t)bench_now_ns()});
+
+        if (result == -3) {
+            atomic_fetch_add_explicit(&rejected, 1, memory_order_relaxed);
+            break;
+        }
+        if (result != 0)
+            exit(1);
+
+        --producer->left;
+    }
+
+    // Sending to itself lets the consumer and other actors run before the next burst.
+    message_type_t next = producer->left > 0 ? MSG_PRODUCE : MSG_GODIE;
+    if (next == MSG_GODIE)
+        free(producer);
+
+    send_message(actor_id_self(), (message_t){.message_type = next, .nbytes = 0, .data = NULL});
+}
+
+static act_t producer_prompts[] = {producer_hello, producer_produce};
+static role_t producer_role = {.nprompts = 2, .prompts = producer_prompts};
+
+static void consumer_hello(__attribute__((unused))void **stateptr,
+                           __attribute__((unused))size_t nbytes,
+                           __attribute__((unused))void *data) {
+    for (size_t i = 0; i < SATURATION_PRODUCERS; ++i)
+        send_message(actor_id_self(), (message_t){.message_type = MSG_SPAWN,
+                                                  .nbytes = sizeof(role_t),
+                                                  .data = &producer_role});
+}
+
+static void consumer_message(__attribute__((unused))void **stateptr,
+                             __attribute__((unused))size_t nbytes, void *data) {
+    histogram_record(&latency, bench_now_ns() - (unsigned long long)(uintptr_t)data);
+
+    if (++received == total)
+        send_message(actor_id_self(), (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                                  .data = NULL});
+}
+
+static act_t consumer_prompts[] = {consumer_hello, consumer_message};
+static role_t consumer_role = {.nprompts = 2, .prompts = consumer_prompts};
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    if (bench_parse_options(argc, argv, 200000, &options) != 0)
+        return 1;
+
+    options.size -= options.size % SATURATION_PRODUCERS;
+    if (options.size == 0)
+        options.size = SATURATION_PRODUCERS;
+
+    for (size_t i = 0; i < options.nworkers; ++i) {
+        for (size_t r = 0; r < options.repetitions; ++r) {
+            total = options.size;
+            received = 0;
+            atomic_store(&rejected, 0);
+            create_histogram(&latency);
+
+            unsigned long long start = bench_now_ns();
+            bench_run_system(options.workers[i], &consumer_role);
+            unsigned long long elapsed = bench_now_ns() - start;
+
+            char extra[64];
+            snprintf(extra, sizeof(extra), "\"rejected\":%llu", atomic_load(&rejected));
+            bench_report("saturation", options.workers[i], options.size, total, elapsed,
+                         "queued", &latency, extra);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+// Skynet: every actor above the last level spawns SKYNET_BRANCHES children, leaves report
+// their numbers and every actor sums the results of its children. Latency is the time of
+// the whole run.
+
+#define SKYNET_BRANCHES 10
+
+#define MSG_START 1
+#define MSG_RESULT 2
+
+static size_t depth;
+static unsigned long long result;
+// Set if some actor could not be spawned or a result could not be sent.
+static atomic_bool failed;
+
+typedef struct assignment {
+    size_t level;
+    unsigned long long number;
+} assignment_t;
+
+typedef struct node {
+    actor_id_t parent;
+    assignment_t assignment;
+    size_t results;
+    unsigned long long sum;
+} node_t;
+
+static role_t node_role;
+
+static void finish(node_t *node, unsigned long long sum) {
+    if (node->assignment.level == 0)
+        result = sum;
+    else if (send_message_inline(node->parent, MSG_RESULT, &sum, sizeof(sum)) != 0)
+        atomic_store(&failed, true);
+
+    free(node);
+    send_message(actor_id_self(), (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                              .data = NULL});
+}
+
+static void start(node_t *node) {
+    if (node->assignment.level == depth) {
+        finish(node, node->assignment.number);
+        return;
+    }
+
+    for (size_t i = 0; i < SKYNET_BRANCHES; ++i) {
+        node_t *child = calloc(1, sizeof(node_t));
+        if (child == NULL)
+            exit(1);
+        child->parent = actor_id_self();
+        child->assignment = (assignment_t){
+                .level = node->assignment.level + 1,
+                .number = node->assignment.number * SKYNET_BRANCHES + i};
+
+        // Children which do not start never report, so they are counted as reported
+        // and the run fails instead of waiting for them. Child which was spawned, but not
+        // started, is retired with MSG_GODIE, its state is never used.
+        actor_id_t child_id;
+        if (actor_spawn(&node_role, child, &child_id) != 0) {
+            free(child);
+            atomic_store(&failed, true);
+            ++node->results;
+        }
+        else if (send_message(child_id, (message_t){.message_type = MSG_START, .nbytes = 0,
+                                                    .data = NULL}) != 0) {
+            send_message(child_id, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                               .data = NULL});
+            free(child);
+            atomic_store(&failed, true);
+            ++node->results;
+        }
+    }
+
+    if (node->results == SKYNET_BRANCHES)
+        finish(node, node->sum);
+}
+
+// Only the first actor gets hello, it is the root of the tree.
+static void node_hello(void **stateptr, __attribute__((unused))size_t nbytes,
+                       __attribute__((unused))void *data) {
+    node_t *node = calloc(1, sizeof(node_t));
+    if (node == NULL)
+        exit(1);
+    *stateptr = node;
+
+    start(node);
+}
+
+static void node_start(void **stateptr, __attribute__((unused))size_t nbytes,
+                       __attribute__((unused))void *data) {
+    start(*stateptr);
+}
+
+static void node_result(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    node_t *node = *stateptr;
+    node->sum += *(unsigned long long *)data;
+
+    if (++node->results == SKYNET_BRANCHES)
+        finish(node, node->sum);
+}
+
+static act_t node_prompts[] = {node_hello, node_start, node_result};
+static role_t node_role = {.nprompts = 3, .prompts = node_prompts};
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    if (bench_parse_options(argc, argv, 5, &options) != 0)
+        return 1;
+
+    // All actors of the tree may be alive at the same time, so the depth is limited to
+    // trees which fit in CAST_LIMIT.
+    unsigned long long leaves = 1;
+    unsigned long long nodes = 0;
+    size_t levels = 0;
+    while (levels < options.size && 1 + nodes + leaves * SKYNET_BRANCHES <= CAST_LIMIT) {
+        leaves *= SKYNET_BRANCHES;
+        nodes += leaves;
+        ++levels;
+    }
+    options.size = levels;
+    unsigned long long expected = leaves * (leaves - 1) / 2;
+
+    int status = 0;
+    for (size_t i = 0; i < options.nworkers; ++i) {
+        for (size_t r = 0; r < options.repetitions; ++r) {
+            depth = options.size;
+            result = 0;
+            atomic_store(&failed, false);
+
+            unsigned long long start_ns = bench_now_ns();
+            bench_run_system(options.workers[i], &node_role);
+            unsigned long long elapsed = bench_now_ns() - start_ns;
+            // Each line reports its own run, as in other benchmarks.
+            histogram_t latency;
+            create_histogram(&latency);
+            histogram_record(&latency, elapsed);
+
+            bool ok = !atomic_load(&failed) && result == expected;
+            if (!ok)
+                status = 1;
+
+            // Every actor but the root is started and returns a result, the root gets
+            // hello, and every actor dies.
+            char extra[64];
+            snprintf(extra, sizeof(extra), "\"sum\":%llu,\"ok\":%s", result,
+                     ok ? "true" : "false");
+            bench_report("skynet", options.workers[i], options.size, 3 * nodes + 2, elapsed,
+                         "run", &latency, extra);
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,100 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+// Every actor spawns up to SPAWN_FAN_OUT children and dies, until the requested number of
+// actors was created. Children are created with actor_spawn, their spawn time is their state,
+// and latency is the time from the spawn to the handling of their start message.
+
+#define MSG_START 1
+
+#define SPAWN_FAN_OUT 8
+
+static size_t target;
+static atomic_size_t claimed;
+static atomic_size_t spawned;
+static pthread_mutex_t latency_mutex = PTHREAD_MUTEX_INITIALIZER;
+static histogram_t latency;
+
+static role_t spawner_role;
+
+static void spawn_children() {
+    size_t first = atomic_fetch_add(&claimed, SPAWN_FAN_OUT);
+    size_t children = first >= target ? 0 : target - first;
+    if (children > SPAWN_FAN_OUT)
+        children = SPAWN_FAN_OUT;
+
+    for (size_t i = 0; i < children; ++i) {
+        actor_id_t child;
+        if (actor_spawn(&spawner_role, (void *)(uintptr_t)bench_now_ns(), &child) != 0)
+            continue;
+
+        // Child which cannot be started has to die anyway, or the system would never finish.
+        if (send_message(child, (message_t){.message_type = MSG_START, .nbytes = 0,
+                                            .data = NULL}) != 0) {
+            send_message(child, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                            .data = NULL});
+            continue;
+        }
+
+        atomic_fetch_add_explicit(&spawned, 1, memory_order_relaxed);
+    }
+
+    send_message(actor_id_self(), (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                              .data = NULL});
+}
+
+// Only the first actor gets MSG_HELLO.
+static void spawner_hello(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    spawn_children();
+}
+
+static void spawner_start(void **stateptr, __attribute__((unused))size_t nbytes,
+                          __attribute__((unused))void *data) {
+    unsigned long long now = bench_now_ns();
+    unsigned long long start = (unsigned long long)(uintptr_t)*stateptr;
+
+    if (pthread_mutex_lock(&latency_mutex) != 0)
+        exit(1);
+    histogram_record(&latency, now > start ? now - start : 0);
+    if (pthread_mutex_unlock(&latency_mutex) != 0)
+        exit(1);
+
+    spawn_children();
+}
+
+static act_t spawner_prompts[] = {spawner_hello, spawner_start};
+static role_t spawner_role = {.nprompts = 2, .prompts = spawner_prompts};
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    if (bench_parse_options(argc, argv, 100000, &options) != 0)
+        return 1;
+
+    if (options.size > CAST_LIMIT)
+        options.size = CAST_LIMIT;
+
+    for (size_t i = 0; i < options.nworkers; ++i) {
+        for (size_t r = 0; r < options.repetitions; ++r) {
+            target = options.size;
+            // The first actor is created by the system.
+            atomic_store(&claimed, 1);
+            atomic_store(&spawned, 1);
+            create_histogram(&latency);
+
+            unsigned long long start = bench_now_ns();
+            bench_run_system(options.workers[i], &spawner_role);
+
+            // One actor spawned is counted as one message.
+            bench_report("spawn_storm", options.workers[i], options.size, atomic_load(&spawned),
+                         bench_now_ns() - start, "spawn_to_start", &latency, NULL);
+        }
+    }
+
+    return 0;
+}
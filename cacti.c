@@ -1,63 +1,428 @@
+#define _GNU_SOURCE
+
 #include <pthread.h>
 #include <semaphore.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
 
 
 #include "cacti.h"
 #include "queue.h"
+#include "mailbox.h"
+#include "slab.h"
+#include "histogram.h"
+#include "timer_wheel.h"
+
+#define CACHE_LINE_SIZE 64
+
+// Actors are kept in chunks of ACTOR_CHUNK_SIZE, which are never moved, so they can be
+// accessed without locking.
+#define ACTOR_CHUNK_SIZE 1024
+#define ACTOR_CHUNKS ((CAST_LIMIT + ACTOR_CHUNK_SIZE - 1) / ACTOR_CHUNK_SIZE)
+
+// Maximal number of ready actors moved by a single steal.
+#define ACTOR_STEAL_LIMIT 32
+
+// Hint for the processor that the thread is busy waiting.
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define CPU_RELAX() ((void)0)
+#endif
+
+// Code executed only if the library is built with CACTI_METRICS.
+#ifdef CACTI_METRICS
+#define METRICS(...) __VA_ARGS__
+#else
+#define METRICS(...)
+#endif
+
+// Code executed only if the library is built with CACTI_LATENCY.
+#ifdef CACTI_LATENCY
+#define LATENCY(...) __VA_ARGS__
+#define LATENCY_DUMP_REQUESTED(system) atomic_load(&(system)->latency_dump)
+#else
+#define LATENCY(...)
+#define LATENCY_DUMP_REQUESTED(system) false
+#endif
+
+// Code executed only if the library is built with CACTI_TRACE.
+#ifdef CACTI_TRACE
+#define TRACE(...) __VA_ARGS__
+#else
+#define TRACE(...)
+#endif
+
+// Maximal number of different pairs of role and message type with latency histograms,
+// separately for each worker. Messages of other pairs are not measured.
+#define ACTOR_LATENCY_KEYS 64
+
+// Multicast schedules actors it woke up in groups of at most this size.
+#define ACTOR_MULTICAST_GROUP 64
+
+// Timers are allocated in chunks, so entries linked in the wheel never move. Timer wheel
+// ticks every millisecond.
+#define ACTOR_TIMER_CHUNK_SIZE 1024
+#define ACTOR_TIMER_GENERATIONS ((uint64_t)1 << 31)
+#define NS_PER_TICK 1000000ULL
+
+// Actor's identifier consists of its slot index and the slot's generation, which changes
+// every time the slot is reused. Messages sent with a stale identifier are rejected.
+#define ACTOR_INDEX_MASK (((uint64_t)1 << 32) - 1)
+#define ACTOR_INDEX(actor) ((size_t)((uint64_t)(actor) & ACTOR_INDEX_MASK))
+
+_Static_assert(sizeof(actor_id_t) == 8, "actor_id_t cannot hold the index and generation");
+
+// [message_queue_t.state] layout: two flags, generation of the slot (at the same bits as
+// in actor's identifier) and number of queued messages.
+#define ACTOR_DEAD ((uint64_t)1 << 63)
+#define ACTOR_SCHEDULED ((uint64_t)1 << 62)
+#define ACTOR_GENERATION ((((uint64_t)1 << 30) - 1) << 32)
+#define ACTOR_NEXT_GENERATION(state) (((state) + ((uint64_t)1 << 32)) & ACTOR_GENERATION)
+#define ACTOR_MESSAGES (((uint64_t)1 << 32) - 1)
+
+// [message_queue_t.ready] layout: generation of the slot and the place of a scheduled
+// actor. It waits in a lane of some ready queue, or it is executed and may ask to be
+// queued in a lane not lower than a given one when its quantum is used up.
+#define ACTOR_READY_NONE (uint64_t)0
+#define ACTOR_READY_QUEUED(lane) ((uint64_t)(lane) + 1)
+#define ACTOR_READY_RUNNING(wanted) ((uint64_t)ACTOR_PRIORITIES + 1 + (uint64_t)(wanted))
+#define ACTOR_READY_PLACE(ready) ((ready) & ~ACTOR_GENERATION)
+
+_Static_assert(ACTOR_QUEUE_LIMIT < ACTOR_MESSAGES, "ACTOR_QUEUE_LIMIT is too big");
+_Static_assert(CAST_LIMIT <= ACTOR_INDEX_MASK, "CAST_LIMIT is too big");
+
+// Envelopes start at cache line boundaries. Fields read by every handler execution come
+// first, so the node, the message and a small payload share one line, and fields of requests
+// and latency follow.
+typedef struct envelope
+{
+    mailbox_node_t node;
+    message_t message;
+    // Small payloads sent with send_message_inline are copied here.
+    _Alignas(max_align_t) unsigned char payload[ACTOR_INLINE_PAYLOAD > 0 ? ACTOR_INLINE_PAYLOAD : 1];
+    bool owns_data;     // [message.data] is a copy freed together with the envelope.
+    // Route of the reply to a message sent with actor_ask or actor_ask_reply, cleared when
+    // it is taken. Future still set when the envelope is released gets no reply.
+    actor_reply_t reply;
+#ifdef CACTI_LATENCY
+    unsigned long long sent_ns;
+#endif
+} envelope_t;
+
+_Static_assert(offsetof(envelope_t, payload) == sizeof(mailbox_node_t) + sizeof(message_t),
+               "inline payload does not follow the message");
+_Static_assert(offsetof(envelope_t, payload) + 32 <= CACHE_LINE_SIZE,
+               "message and default inline payload do not fit in a cache line");
+
+typedef struct message_queue
+{
+    // Dead flag, scheduled flag (actor is in some ready queue or being executed), slot
+    // generation and number of messages in all [mailboxes]. Changed only atomically.
+    _Atomic uint64_t state;
+    // Place of the scheduled actor. Its identifier may be in several lanes of ready queues
+    // after it was promoted to a higher one, but it is executed only from the lane stored
+    // here and the others are skipped.
+    _Atomic uint64_t ready;
+    mailbox_t mailboxes[ACTOR_PRIORITIES];  // One lane per priority.
+} message_queue_t;
+
+#ifdef CACTI_METRICS
+typedef struct actor_metrics
+{
+    atomic_ullong processed;    // Changed only by the worker executing the actor.
+    atomic_ullong rejected;     // Messages refused because the queue was full.
+    atomic_size_t high_water;   // Maximal number of queued messages.
+} actor_metrics_t;
 
-#define DATA_SIZE 32
+// Counters of one thread. Threads outside of the thread pool share one set.
+typedef struct worker_metrics
+{
+    atomic_ullong processed;
+    atomic_ullong sent;
+    atomic_ullong rejected;
+    atomic_ullong runs;
+    atomic_ullong steals;
+    atomic_ullong stolen;
+    atomic_ullong busy_ns;
+    atomic_ullong idle_ns;
+    atomic_ullong lock_wait_ns;
+} worker_metrics_t;
+#endif
+
+#ifdef CACTI_TRACE
+enum trace_event_type
+{
+    TRACE_HANDLER_BEGIN,
+    TRACE_HANDLER_END,
+    TRACE_SPAWN,
+    TRACE_GODIE,
+    TRACE_STEAL,
+    TRACE_PARK,
+    TRACE_UNPARK,
+};
+
+// Fields are atomic, so a trace may be written while workers overwrite old events.
+typedef struct trace_event
+{
+    atomic_ullong ns;
+    atomic_long actor;
+    atomic_long arg;    // Message type, parent of a spawned actor or number of stolen actors.
+    atomic_int type;
+} trace_event_t;
+#endif
+
+#ifdef CACTI_LATENCY
+// Latency of messages of one type sent to actors of one role, which is identified by
+// its prompts.
+typedef struct latency_entry
+{
+    act_t *prompts;
+    message_type_t message_type;
+    histogram_t queue_ns;       // From sending to taking the message from the mailbox.
+    histogram_t handler_ns;     // Execution of the message.
+} latency_entry_t;
+#endif
+
+enum future_state
+{
+    FUTURE_PENDING,
+    FUTURE_REPLIED,
+    FUTURE_BROKEN,      // Request was released without a reply.
+};
 
-typedef struct state_ptr_type
+struct actor_future
 {
-    void *state;
-} state_ptr_t;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_int state;
+    message_t reply;            // Written before [state] changes.
+    atomic_int references;      // Of the asker and of the route of the reply.
+};
+
+// Message sent by the timer thread. Identifier of a timer is its generation shifted as in
+// identifiers of actors, and its index.
+typedef struct timer_entry
+{
+    wheel_timer_t node;         // First, so expired nodes are entries.
+    unsigned long long period;  // Ticks between sends, 0 for timers which fire once.
+    actor_id_t actor;
+    message_t message;
+    size_t index;
+    uint64_t generation;
+    bool active;
+} timer_entry_t;
 
 typedef struct actor_properties
 {
-    bool is_dead;
+    // Each actor has its own cache line, so senders to different actors do not interfere.
+    _Alignas(CACHE_LINE_SIZE) message_queue_t message_queue;
     role_t role;
-    queue_t message_queue;
-    state_ptr_t *state;
-    pthread_mutex_t mutex;
+    void *state;
+    size_t turn;    // Messages taken so far, changed only by the worker executing the actor.
+#ifdef CACTI_METRICS
+    actor_metrics_t metrics;
+#endif
 } actor_properties_t;
 
-typedef struct system
+typedef struct worker
+{
+    // Workers do not share cache lines.
+    _Alignas(CACHE_LINE_SIZE) pthread_t thread;
+    actor_system_t *system;
+    size_t index;
+    // Ready actors, one lane per priority. Other workers steal from them when idle.
+    queue_t actor_queues[ACTOR_PRIORITIES];
+    pthread_mutex_t actor_queue_mutex;
+    size_t turn;    // Actors taken from own queues so far, guarded by [actor_queue_mutex].
+    slab_pool_t envelope_pool;  // Messages sent by this worker.
+    // Processors of the thread, if it is pinned. Kept for spare workers, which are started
+    // after the configuration is gone.
+    bool pinned;
+    cpu_set_t cpus;
+#ifdef CACTI_METRICS
+    // Other workers lock [actor_queue_mutex], so counters are on a separate cache line.
+    _Alignas(CACHE_LINE_SIZE) worker_metrics_t metrics;
+#endif
+#ifdef CACTI_LATENCY
+    // Open addressing by role and message type. Entries are added only by the worker.
+    _Atomic(latency_entry_t *) latency[ACTOR_LATENCY_KEYS];
+#endif
+#ifdef CACTI_TRACE
+    // Ring buffer of the last ACTOR_TRACE_EVENTS events, written only by the worker.
+    trace_event_t *trace;
+    atomic_size_t trace_head;   // Number of events ever written.
+#endif
+} worker_t;
+
+struct actor_system
 {
-    size_t dead_count;
+    // Limits from the configuration.
+    size_t queue_limit;
+    size_t cast_limit;
+    size_t throughput;
+    size_t idle_spins;
+    size_t idle_yields;
+
+    // Actors which are alive or still have messages to handle.
     size_t actor_count;
-    size_t actors_capacity;
-    actor_properties_t *actors;
+    // Number of slots ever used. It is read without locking, so it is increased only
+    // after the new slot is initialized.
+    atomic_size_t slot_count;
+    queue_t free_slots;     // Slots of released actors, reused before new ones.
+    _Atomic(actor_properties_t *) actor_chunks[ACTOR_CHUNKS];
     pthread_mutex_t system_state_mutex;
 
-    queue_t actor_queue;
-    pthread_mutex_t actor_queue_mutex;
-    
+    size_t pool_size;
+    size_t spare_limit;     // Spare workers, which follow the [pool_size] ones in [workers].
+    worker_t *workers;
+    // Workers whose threads were started. Spare ones are started in order, by the first
+    // blocking section which needs them, and parked when it ends.
+    atomic_size_t worker_count;
+    atomic_size_t blocked;      // Workers in blocking sections, changed under [idle_mutex].
+    pthread_cond_t spare_cond;  // Parked spare workers wait on it with [idle_mutex].
+    atomic_size_t next_worker;  // Round robin for actors woken outside of worker threads.
+
+    // Messages sent from outside of the thread pool.
+    slab_pool_t external_pool;
+    pthread_mutex_t external_pool_mutex;
+
+    pthread_mutex_t idle_mutex;
     pthread_cond_t cond;
-    pthread_t threads[POOL_SIZE];
+    // Workers waiting on [cond]. Changed under [idle_mutex], but read without it.
+    atomic_size_t sleepers;
     bool all_work_done; // True if all actors died.
 
-    struct sigaction old_action;
     bool interrupted;   // True if SIGINT was send.
-    bool all_threads_returned;
+    atomic_bool all_threads_returned;
     size_t returned_threads; // Counter.
 
-    pthread_rwlock_t realloc_safety;
-} actor_system_t;
+    // Timers are handled by a thread started with the first of them. Fields are guarded
+    // by [timer_mutex].
+    pthread_mutex_t timer_mutex;
+    pthread_cond_t timer_cond;
+    pthread_t timer_thread;
+    bool timer_thread_started;
+    bool timer_thread_stopped;
+    timer_wheel_t timer_wheel;
+    timer_entry_t **timer_chunks;
+    size_t timer_chunk_count;
+    size_t timer_slot_count;    // Number of entries ever used.
+    queue_t free_timers;        // Indexes of entries which are not active.
+
+#ifdef CACTI_METRICS
+    worker_metrics_t external_metrics;
+    unsigned long long spawns;  // Guarded by [system_state_mutex].
+    unsigned long long deaths;  // Guarded by [system_state_mutex].
+#endif
+#ifdef CACTI_TRACE
+    char *trace_file;           // Written by actor_system_wait, if not NULL.
+    unsigned long long trace_start_ns;
+#endif
+#ifdef CACTI_LATENCY
+    atomic_bool latency_dump;   // Set by SIGUSR1, some worker prints histograms to stderr.
+#endif
+};
+
+// System used by functions which do not take one as an argument outside of thread pools.
+actor_system_t *default_system;
+
+// Systems which are not destroyed yet. SIGINT interrupts all of them, so the handler is set
+// while there is at least one. Slots are changed only under [systems_mutex].
+_Atomic(actor_system_t *) systems[ACTOR_MAX_SYSTEMS];
+size_t systems_count;
+pthread_mutex_t systems_mutex = PTHREAD_MUTEX_INITIALIZER;
+struct sigaction old_action;
+LATENCY(struct sigaction old_dump_action;)
 
-actor_system_t *actor_system;
 _Thread_local actor_id_t thread_actor;
+_Thread_local worker_t *thread_worker;  // NULL outside of the thread pool.
+_Thread_local size_t thread_blocking;   // Depth of nested blocking sections.
+_Thread_local envelope_t *thread_envelope;  // Message being handled by the worker.
 
 
 // Function is not thread-safe - system_state_mutex must be locked before entering
 // the function and unlocked after.
-int create_actor(actor_id_t id, role_t *const role);
+int create_actor(actor_system_t *system, actor_id_t *id, role_t *const role);
+
+// Gives the slot of a dead actor with no messages back for new actors.
+void release_actor(actor_system_t *system, actor_id_t actor);
+
+// Returns properties of an existing actor. They do not move until the system is destroyed.
+actor_properties_t *get_actor(actor_system_t *system, actor_id_t actor);
+
+int create_thread_pool(actor_system_t *system, const actor_system_config_t *config);
+
+// Fills [cpus] with processors the worker [index] should run on. Returns 1 if it should not
+// be pinned, -1 if requested processors cannot be found.
+int worker_affinity(const actor_system_config_t *config, size_t index, cpu_set_t *cpus);
+
+// Starts the thread of worker [w] on its processors.
+int start_worker(worker_t *w);
+
+// Adds processors of NUMA [node] to [cpus], as listed by sysfs. Returns -1 if the node
+// is not known.
+int add_numa_node_cpus(int node, cpu_set_t *cpus);
+
+// Adds [system] to [systems]. Sets SIGINT action if it is the first one.
+int register_system(actor_system_t *system);
+
+// Removes [system] from [systems]. Resets SIGINT action if it was the last one.
+void unregister_system(actor_system_t *system);
+
+// Checks if threads of all registered systems returned.
+bool all_systems_returned();
+
+// Returns the system of the calling worker, or the default one outside of thread pools.
+actor_system_t *current_system();
+
+// Locks [mutex]. With CACTI_METRICS time spent waiting is added to the calling thread's
+// counters.
+void lock_mutex(actor_system_t *system, pthread_mutex_t *mutex);
+
+unsigned long long monotonic_ns();
+
+#ifdef CACTI_METRICS
+// Counters of the calling thread in [system].
+worker_metrics_t *thread_metrics(actor_system_t *system);
+
+void copy_worker_metrics(const worker_metrics_t *metrics, actor_worker_stats_t *stats);
 
-int create_thread_pool();
+void add_worker_stats(actor_worker_stats_t *total, const actor_worker_stats_t *stats);
+#endif
+
+#ifdef CACTI_TRACE
+void trace(worker_t *worker, enum trace_event_type type, actor_id_t actor, long arg);
+
+// Writes events of [worker] with number [index] as Chrome trace events.
+void write_trace_events(actor_system_t *system, size_t index, FILE *file, bool *first);
+#endif
+
+#ifdef CACTI_LATENCY
+// Returns histograms of [worker] for [message_type] and actors with [prompts]. Returns NULL
+// if there is no place for them.
+latency_entry_t *latency_entry(worker_t *worker, act_t *prompts, message_type_t message_type);
+
+// Allocates an entry with empty histograms.
+latency_entry_t *create_latency_entry(act_t *prompts, message_type_t message_type);
+
+void print_latency_entry(int fd, const char *prefix, const latency_entry_t *entry);
+
+// SIGUSR1 action.
+void request_latency_dump(int sig);
+#endif
 
 // New SIGINT action.
 void block_system(int sig);
@@ -65,515 +430,2459 @@ void block_system(int sig);
 // Changes SIGINT action to [block_system].
 int set_signal_operation();
 
+int create_ready_queues(worker_t *worker);
+
+void delete_ready_queues(worker_t *worker);
+
+// Initializes timer fields of [system], without starting the timer thread.
+int create_timers(actor_system_t *system);
+
+// Stops the timer thread and frees all timers.
+void destroy_timers(actor_system_t *system);
+
+unsigned long long current_tick();
+
+timer_entry_t *get_timer(actor_system_t *system, size_t index);
+
+// Takes an inactive entry, or allocates a new one. [timer_mutex] must be locked.
+timer_entry_t *acquire_timer(actor_system_t *system);
+
+// Makes the entry inactive, its identifier becomes stale. [timer_mutex] must be locked.
+void release_timer(actor_system_t *system, timer_entry_t *timer);
+
+// Adds a timer sending [message] to [actor] after [delay] and then every [period] ticks,
+// if [period] is not 0.
+int add_timer(actor_system_t *system, actor_id_t actor, message_t message,
+              unsigned long long delay, unsigned long long period, actor_timer_t *timer);
+
+// Sends messages of expired timers. Timers which fire again are put back into the wheel.
+// [timer_mutex] must be locked.
+void fire_timers(actor_system_t *system, wheel_timer_t *expired);
+
+// Waits for the tick of the nearest timer and fires it, until the system is destroyed.
+void *timer_thread(void *data);
+
 // Threads execution.
 void *worker (void *data);
 
-// Pops message form [actor]'s queue and executes it.
-void work_with_actor(actor_id_t actor);
+// Checks if spare [worker] compensates for a worker in a blocking section.
+bool spare_needed(worker_t *worker);
 
-// MSG_GODIE execution. [realloc_safety] and actor's mutex must be locked while entering
-// the function.
-void go_die(actor_id_t actor);
+// Moves ready actors of spare [worker] to a worker of the pool and waits until a blocking
+// section needs it again. Returns false if the system finished meanwhile.
+bool park_spare(worker_t *worker);
 
-// MSG_SPAWN execution.
-void spawn(message_t message, actor_id_t actor);
+// Pops an actor from [worker]'s queue or steals one. Before giving up it polls the queues
+// [idle_spins] times with busy waiting and [idle_yields] times with yielding the processor.
+bool find_actor(worker_t *worker, actor_id_t *actor);
 
-// Checks if actor with given id exists.
-bool actor_exists(actor_id_t actor);
+// Pops messages from [actor]'s queue and executes them, until the queue is empty or
+// [system]'s throughput messages or ACTOR_TIME_BUDGET microseconds are used up.
+void work_with_actor(actor_system_t *system, actor_id_t actor);
 
-// Changes SIGINT action to default.
-int reset_signal_operation();
+// Returns the lane to be checked first at the [turn]-th pop from lanes of some queue. Lanes
+// are checked from there in order of decreasing priority, then from the highest one.
+size_t first_lane(size_t turn);
 
-// Destroys [created_threads_count] threads from threads' pool.
-void destroy_thread_pool(size_t created_threads_count);
+// Pops a message from lanes of [properties]'s mailbox. Returns NULL if none is linked yet.
+mailbox_node_t *pop_message(actor_properties_t *properties);
 
-void destroy_actors();
+// Returns the highest priority of messages which are waiting for [properties]'s actor.
+actor_priority_t waiting_priority(actor_properties_t *properties);
 
-void destroy_actor_system();
+long elapsed_microseconds(const struct timespec *since);
 
+// Takes [count] envelopes from the calling thread's pool, or from the external pool of
+// [system] if the thread is not its worker. Returned envelopes are linked by their nodes.
+envelope_t *create_envelopes(actor_system_t *system, size_t count);
 
-int create_actor(actor_id_t id, role_t *const role) {
-    if (actor_system->actor_count == CAST_LIMIT)
-        return -2;
+// Returns [envelope] to the pool it was taken from.
+void release_envelope(envelope_t *envelope);
 
-    // If furthest part of actor creation failed, current [actor_system->actors] capacity would
-    // not be regained.
-    ++actor_system->actor_count;
-    if (actor_system->actor_count > actor_system->actors_capacity) {
-        // [actor_system->actors] cannot be read during capacity change.
-        if (pthread_rwlock_wrlock(&actor_system->realloc_safety) != 0)
-            exit(1);
+// Releases envelopes linked by their nodes, starting from [first].
+void release_envelopes(envelope_t *first);
 
-        actor_system->actors = realloc(actor_system->actors,
-                2 * actor_system->actors_capacity * sizeof(actor_properties_t));
-        if (actor_system->actors == NULL)
-            exit(1);
+// Sends [count] envelopes, linked by their nodes from [first] to [last], to [actor] with
+// [priority]. Releases them if they cannot be sent.
+int send_envelopes(actor_system_t *system, actor_id_t actor, envelope_t *first, envelope_t *last,
+                   size_t count, actor_priority_t priority);
 
-        actor_system->actors_capacity *= 2;
+// Allocates a future referenced by the asker and by the route of the reply.
+actor_future_t *create_future();
 
-        if (pthread_rwlock_unlock(&actor_system->realloc_safety) != 0)
-            exit(1);
-    }
+// Gives [future] its [reply], or none if it is NULL, and drops the reference of the route.
+void complete_future(actor_future_t *future, const message_t *reply);
 
-    actor_system->actors[id].role.nprompts = role->nprompts;
-    actor_system->actors[id].role.prompts = role->prompts;
-    actor_system->actors[id].is_dead = false;
-    actor_system->actors[id].state = malloc(sizeof(state_ptr_t));
-    if (actor_system->actors[id].state == NULL)
-        goto STATE_ERROR;
-    actor_system->actors[id].state->state = NULL;
+// Drops a reference to [future]. The last one frees it.
+void release_future(actor_future_t *future);
 
-    if (create_queue(&actor_system->actors[id].message_queue) != 0)
-        goto ALLOC_ERROR;
+// Sends [message] to [actor] with [route] of its reply.
+int send_request(actor_system_t *system, actor_id_t actor, message_t message,
+                 actor_reply_t route);
 
-    if (pthread_mutex_init(&actor_system->actors[id].mutex, 0) != 0)
-        goto MUTEX_ERROR;
+// Reserves place for [count] messages in [actor]'s queue, for all of them or for none.
+// Returns -1 if the actor is dead, -3 if the messages do not fit, 1 if the actor was idle
+// and the caller has to schedule it, 0 otherwise.
+int reserve_messages(actor_system_t *system, actor_id_t actor, size_t count);
 
-    return 0;
+// Pushes [actor] to the [priority] lane of the ready queue of the calling worker or, if called
+// from outside of [system]'s thread pool, of the next worker in round robin order, and wakes
+// a parked worker. The actor has to be marked as waiting in that lane first.
+void schedule_actor(actor_system_t *system, actor_id_t actor, actor_priority_t priority);
 
-    MUTEX_ERROR:
-    delete_queue(&actor_system->actors[id].message_queue);
-    ALLOC_ERROR:
-    free(actor_system->actors[id].state);
-    STATE_ERROR:
-    --actor_system->actor_count;
-    return -1;
-}
+// Works as [schedule_actor] for [count] actors, but locks the ready queue once and wakes
+// at most one parked worker per actor.
+void schedule_actors(actor_system_t *system, const actor_id_t *actors, size_t count,
+                     actor_priority_t priority);
 
-int create_thread_pool() {
-    for (size_t i = 0; i < POOL_SIZE; ++i) {
-        if (pthread_create(&actor_system->threads[i], NULL, worker, NULL) != 0) {
-            destroy_thread_pool(i);
-            return -1;
-        }
-    }
+// Marks [actor], which has just been woken by a message of [priority], as waiting in the
+// lane it has to be pushed to. Returns the lane, which is higher than [priority] if other
+// senders have asked for it meanwhile.
+actor_priority_t mark_actor_queued(actor_system_t *system, actor_id_t actor,
+                                   actor_priority_t priority);
 
-    return 0;
-}
+// Moves [actor], which is already scheduled, to the [priority] lane if it waits in a lower
+// one. Executed actor is requeued in that lane when its quantum is used up.
+void promote_actor(actor_system_t *system, actor_id_t actor, actor_priority_t priority);
 
-void block_system(__attribute__((unused))int sig) {
-    actor_system->interrupted = true;
+// Marks [actor], popped from [lane], as executed. Returns false if it waits in another lane,
+// so it is executed from there.
+bool claim_actor(actor_system_t *system, actor_id_t actor, size_t lane);
 
-    if (actor_system->all_threads_returned) {
-        destroy_actor_system();
-        raise(SIGINT);
-    } else {
-        pthread_cond_broadcast(&actor_system->cond);
-    }
-}
+// Pops an actor from [worker]'s queue and sets [lane] to the lane it was in. Returns false
+// if the queue is empty.
+bool pop_local_actor(worker_t *worker, actor_id_t *actor, size_t *lane);
 
-int set_signal_operation() {
-    struct sigaction new_action;
-    sigset_t block_mask;
+// Moves half of the highest non-empty lane of some other worker's ready queue to the same
+// lane of [worker]'s queue and pops one of them. Returns false if there was nothing to steal.
+bool steal_actors(worker_t *worker, actor_id_t *actor, size_t *lane);
 
-    sigemptyset(&block_mask);
+// Checks if any worker has ready actors. [idle_mutex] must be locked.
+bool work_available(actor_system_t *system);
 
-    new_action.sa_handler = block_system;
-    new_action.sa_mask = block_mask;
-    new_action.sa_flags = SA_RESTART;
+// MSG_GODIE execution.
+void go_die(message_queue_t *queue);
 
-    if (sigaction(SIGINT, &new_action, &actor_system->old_action) != 0)
-        return -1;
+// MSG_SPAWN execution.
+void spawn(actor_system_t *system, message_t message, actor_id_t actor);
 
-    return 0;
-}
+// Checks if actor with given id exists.
+bool actor_exists(actor_system_t *system, actor_id_t actor);
 
-void *worker (__attribute__((unused))void *data) {
-    actor_id_t *current_actor_ptr, current_actor;
+// Changes SIGINT action to default.
+int reset_signal_operation();
 
-    while (actor_system->actor_count == 0 || actor_system->actor_count != actor_system->dead_count) {
-        if (pthread_mutex_lock(&actor_system->actor_queue_mutex) != 0)
-            exit(1);
+// Destroys [created_threads_count] threads from threads' pool.
+void destroy_thread_pool(actor_system_t *system, size_t created_threads_count);
 
-        while (!actor_system->interrupted && !actor_system->all_work_done &&
-               empty(&actor_system->actor_queue)) {
-            if (pthread_cond_wait(&actor_system->cond, &actor_system->actor_queue_mutex) != 0)
-                exit(1);
-        }
+// Frees ready queues and envelope pools of all workers.
+void destroy_workers(actor_system_t *system);
 
-        // If all actors are dead and no more messages stayed at any actor's queue.
-        if ((actor_system->all_work_done || actor_system->interrupted) &&
-            empty(&actor_system->actor_queue)) {
-            if (pthread_mutex_unlock(&actor_system->actor_queue_mutex) != 0)
-                exit(1);
+void destroy_actors(actor_system_t *system);
 
-            break;
-        }
+void destroy_actor_system(actor_system_t *system);
 
-        current_actor_ptr = (actor_id_t *)pop(&actor_system->actor_queue);
-        current_actor = *current_actor_ptr;
-        free(current_actor_ptr);
 
-        if (pthread_mutex_unlock(&actor_system->actor_queue_mutex) != 0)
-            exit(1);
+int create_actor(actor_system_t *system, actor_id_t *id, role_t *const role) {
+    if (system->actor_count == system->cast_limit)
+        return -2;
 
-        work_with_actor(current_actor);
+    size_t index;
+    bool new_slot = empty(&system->free_slots);
+    if (!new_slot) {
+        index = (size_t)pop(&system->free_slots);
     }
+    else {
+        index = atomic_load(&system->slot_count);
 
-    if (pthread_cond_signal(&actor_system->cond) != 0)
-        exit(1);
+        size_t chunk = index / ACTOR_CHUNK_SIZE;
+        actor_properties_t *actors = atomic_load(&system->actor_chunks[chunk]);
+        if (actors == NULL) {
+            actors = aligned_alloc(CACHE_LINE_SIZE, ACTOR_CHUNK_SIZE * sizeof(actor_properties_t));
+            if (actors == NULL)
+                return -1;
 
-    if (pthread_mutex_lock(&actor_system->system_state_mutex) != 0)
-        exit(1);
+            atomic_store(&system->actor_chunks[chunk], actors);
+        }
 
-    actor_system->returned_threads++;
-    actor_system->all_threads_returned = actor_system->returned_threads == POOL_SIZE;
-    // If all other threads returned and actors' system was interrupted by SIGINT,
-    // program has to be killed.
-    if (actor_system->all_threads_returned && actor_system->interrupted) {
-        if (pthread_mutex_unlock(&actor_system->system_state_mutex) != 0)
-            exit(1);
-        reset_signal_operation();
-        raise(SIGINT);
+        atomic_init(&actors[index % ACTOR_CHUNK_SIZE].message_queue.state, ACTOR_DEAD);
     }
 
-    if (pthread_mutex_unlock(&actor_system->system_state_mutex) != 0)
-        exit(1);
+    actor_properties_t *new_actor = get_actor(system, (actor_id_t)index);
+    new_actor->role.nprompts = role->nprompts;
+    new_actor->role.prompts = role->prompts;
+    new_actor->state = NULL;
+    new_actor->turn = 0;
+    for (size_t i = 0; i < ACTOR_PRIORITIES; ++i)
+        create_mailbox(&new_actor->message_queue.mailboxes[i]);
+
+    // Released slot already has a new generation, senders with stale identifiers cannot
+    // reserve place in its mailbox.
+    uint64_t generation = atomic_load(&new_actor->message_queue.state) & ACTOR_GENERATION;
+    atomic_store(&new_actor->message_queue.state, generation);
+    atomic_store(&new_actor->message_queue.ready, generation | ACTOR_READY_NONE);
+
+    // Publishes the new slot for senders.
+    if (new_slot)
+        atomic_store(&system->slot_count, index + 1);
+
+    METRICS(
+        atomic_store_explicit(&new_actor->metrics.processed, 0, memory_order_relaxed);
+        atomic_store_explicit(&new_actor->metrics.rejected, 0, memory_order_relaxed);
+        atomic_store_explicit(&new_actor->metrics.high_water, 0, memory_order_relaxed);
+        ++system->spawns;
+    )
+
+    ++system->actor_count;
+    *id = (actor_id_t)(generation | index);
 
-    return NULL;
+    return 0;
 }
 
-void work_with_actor(actor_id_t actor) {
-    thread_actor = actor;
-
-    if (pthread_rwlock_rdlock(&actor_system->realloc_safety) != 0)
-        exit(1);
+void release_actor(actor_system_t *system, actor_id_t actor) {
+    lock_mutex(system, &system->system_state_mutex);
 
-    if (pthread_mutex_lock(&actor_system->actors[actor].mutex) != 0)
+    if (push(&system->free_slots, (void *)ACTOR_INDEX(actor)) != 0)
         exit(1);
 
-    message_t *current_message = (message_t *)pop(&actor_system->actors[actor].message_queue);
-    bool actor_has_more_messages = !empty(&actor_system->actors[actor].message_queue);
+    METRICS(++system->deaths;)
 
-    // It needs to be done with actor's mutex locked, because no more messages may be received.
-    if (current_message->message_type == MSG_GODIE) {
-        go_die(actor);
-        free(current_message);
-        return;
-    }
+    // Only living actors spawn new ones, so no actor will appear any more.
+    bool all_work_done = --system->actor_count == 0;
 
-    if (pthread_mutex_unlock(&actor_system->actors[actor].mutex) != 0)
+    if (pthread_mutex_unlock(&system->system_state_mutex) != 0)
         exit(1);
 
-    if (current_message->message_type == MSG_SPAWN) {
-        if (pthread_rwlock_unlock(&actor_system->realloc_safety) != 0)
+    if (all_work_done) {
+        if (pthread_mutex_lock(&system->idle_mutex) != 0)
+            exit(1);
+
+        // Idle workers have to check whether they can return.
+        system->all_work_done = true;
+        if (pthread_cond_broadcast(&system->cond) != 0 ||
+            pthread_cond_broadcast(&system->spare_cond) != 0)
             exit(1);
 
-        spawn(*current_message, actor);
+        if (pthread_mutex_unlock(&system->idle_mutex) != 0)
+            exit(1);
     }
-    else {
-        // Given message type is not defined for this actor.
-        if ((size_t)current_message->message_type >= actor_system->actors[actor].role.nprompts) {
-            free(current_message);
-            return;
+}
+
+actor_properties_t *get_actor(actor_system_t *system, actor_id_t actor) {
+    actor_properties_t *actors = atomic_load_explicit(
+            &system->actor_chunks[ACTOR_INDEX(actor) / ACTOR_CHUNK_SIZE], memory_order_acquire);
+
+    return &actors[ACTOR_INDEX(actor) % ACTOR_CHUNK_SIZE];
+}
+
+int create_thread_pool(actor_system_t *system, const actor_system_config_t *config) {
+    size_t initialized;
+    for (initialized = 0; initialized < system->pool_size + system->spare_limit; ++initialized) {
+        worker_t *w = &system->workers[initialized];
+        w->system = system;
+        w->index = initialized;
+        w->turn = 0;
+
+        // Spare workers are placed as if the pool was bigger.
+        int pinned = worker_affinity(config, initialized, &w->cpus);
+        if (pinned == -1)
+            goto QUEUES_ERROR;
+        w->pinned = pinned == 0;
+
+        if (create_ready_queues(w) != 0)
+            goto QUEUES_ERROR;
+
+        if (pthread_mutex_init(&w->actor_queue_mutex, 0) != 0) {
+            delete_ready_queues(w);
+            goto QUEUES_ERROR;
         }
 
-        size_t nbytes = current_message->nbytes;
-        void *data = current_message->data;
+#ifdef CACTI_TRACE
+        w->trace = malloc(ACTOR_TRACE_EVENTS * sizeof(trace_event_t));
+        if (w->trace == NULL) {
+            pthread_mutex_destroy(&w->actor_queue_mutex);
+            delete_ready_queues(w);
+            goto QUEUES_ERROR;
+        }
+        atomic_init(&w->trace_head, 0);
+#endif
 
-        act_t service = actor_system->actors[actor].role.prompts[current_message->message_type];
+        // Slabs are allocated by the worker itself, so they are local to its NUMA node.
+        create_slab_pool(&w->envelope_pool, sizeof(envelope_t));
 
-        state_ptr_t *state_ptr = actor_system->actors[actor].state;
+        METRICS(memset(&w->metrics, 0, sizeof(worker_metrics_t));)
+        LATENCY(
+            for (size_t i = 0; i < ACTOR_LATENCY_KEYS; ++i)
+                atomic_init(&w->latency[i], NULL);
+        )
+    }
 
-        if (pthread_rwlock_unlock(&actor_system->realloc_safety) != 0)
-            exit(1);
+    for (size_t i = 0; i < system->pool_size; ++i) {
+        if (start_worker(&system->workers[i]) != 0) {
+            destroy_thread_pool(system, i);
+            return -1;
+        }
+    }
+
+    return 0;
 
-        service(&state_ptr->state, nbytes, data);
+    QUEUES_ERROR:
+    for (size_t i = 0; i < initialized; ++i) {
+        pthread_mutex_destroy(&system->workers[i].actor_queue_mutex);
+        delete_ready_queues(&system->workers[i]);
+        TRACE(free(system->workers[i].trace);)
     }
+    return -1;
+}
 
-    if (actor_has_more_messages) {
-        if (pthread_mutex_lock(&actor_system->actor_queue_mutex) != 0)
-            exit(1);
+int create_ready_queues(worker_t *worker) {
+    for (size_t i = 0; i < ACTOR_PRIORITIES; ++i) {
+        if (create_queue(&worker->actor_queues[i]) != 0) {
+            while (i-- > 0)
+                delete_queue(&worker->actor_queues[i]);
+            return -1;
+        }
+    }
 
-        actor_id_t *actor_id = malloc(sizeof(actor_id_t));
-        *actor_id = actor;
-        if (push(&actor_system->actor_queue, actor_id) != 0)
-            exit(1);
+    return 0;
+}
 
-        if (pthread_mutex_unlock(&actor_system->actor_queue_mutex) != 0)
-            exit(1);
+void delete_ready_queues(worker_t *worker) {
+    for (size_t i = 0; i < ACTOR_PRIORITIES; ++i)
+        delete_queue(&worker->actor_queues[i]);
+}
+
+int worker_affinity(const actor_system_config_t *config, size_t index, cpu_set_t *cpus) {
+    CPU_ZERO(cpus);
+
+    if (config->affinity != NULL && config->naffinity > 0) {
+        const actor_cpu_mask_t *mask = &config->affinity[index % config->naffinity];
+        for (size_t cpu = 0; cpu < ACTOR_MAX_CPUS && cpu < CPU_SETSIZE; ++cpu) {
+            if ((mask->bits[cpu / 64] >> (cpu % 64)) & 1)
+                CPU_SET(cpu, cpus);
+        }
+    }
+    else if (config->numa_nodes != NULL && config->nnuma_nodes > 0) {
+        if (add_numa_node_cpus(config->numa_nodes[index % config->nnuma_nodes], cpus) != 0)
+            return -1;
+    }
+    else if (config->pin_workers) {
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0)
+            return -1;
+
+        size_t skip = index % CPU_COUNT(&allowed);
+        for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed) && skip-- == 0) {
+                CPU_SET(cpu, cpus);
+                break;
+            }
+        }
+    }
+    else {
+        return 1;
     }
 
-    free(current_message);
+    return CPU_COUNT(cpus) > 0 ? 0 : -1;
 }
 
-void go_die(actor_id_t actor) {
-    bool was_dead = actor_system->actors[actor].is_dead;
+int start_worker(worker_t *w) {
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) != 0)
+        return -1;
 
-    actor_system->actors[actor].is_dead = true;
+    // Affinity is set before the thread starts, so its slabs are allocated on its node.
+    int err = 0;
+    if ((w->pinned && pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &w->cpus) != 0) ||
+        pthread_create(&w->thread, &attr, worker, w) != 0)
+        err = -1;
 
-    if (pthread_mutex_unlock(&actor_system->actors[actor].mutex) != 0)
-        exit(1);
+    pthread_attr_destroy(&attr);
+    return err;
+}
 
-    if (pthread_rwlock_unlock(&actor_system->realloc_safety) != 0)
-        exit(1);
+int add_numa_node_cpus(int node, cpu_set_t *cpus) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
 
-    if (was_dead)
-        return;
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
 
-    if (pthread_mutex_lock(&actor_system->system_state_mutex) != 0)
-        exit(1);
+    // List has form like "0-3,8-11".
+    unsigned first, last;
+    while (fscanf(file, "%u", &first) == 1) {
+        last = first;
+        if (fscanf(file, "-%u", &last) < 0)
+            break;
 
-    ++actor_system->dead_count;
-    actor_system->all_work_done = actor_system->dead_count == actor_system->actor_count;
+        for (unsigned cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(cpu, cpus);
 
-    if (pthread_mutex_unlock(&actor_system->system_state_mutex) != 0)
-        exit(1);
+        if (fgetc(file) != ',')
+            break;
+    }
+
+    fclose(file);
+    return 0;
 }
 
-void spawn(message_t message, actor_id_t actor) {
-    if (actor_system->interrupted)
-        return;
+int register_system(actor_system_t *system) {
+    int err = -1;
 
-    if (pthread_mutex_lock(&actor_system->system_state_mutex) != 0)
+    if (pthread_mutex_lock(&systems_mutex) != 0)
         exit(1);
 
-    actor_id_t new_actor_id = actor_system->actor_count;
+    for (size_t i = 0; i < ACTOR_MAX_SYSTEMS; ++i) {
+        if (atomic_load(&systems[i]) != NULL)
+            continue;
 
-    int err;
-    if ((err = create_actor(new_actor_id, message.data)) == -1)
-        exit(1);
-    // If actor cannot be created due to CAST_LIMIT, nothing happens.
-    if (err == -2) {
-        if (pthread_mutex_unlock(&actor_system->system_state_mutex) != 0)
-            exit(1);
+        if (systems_count == 0 && set_signal_operation() != 0)
+            break;
 
-        return;
+        atomic_store(&systems[i], system);
+        ++systems_count;
+        err = 0;
+        break;
     }
 
-    if (pthread_mutex_unlock(&actor_system->system_state_mutex) != 0)
+    if (pthread_mutex_unlock(&systems_mutex) != 0)
         exit(1);
 
-    // New actor should receive hello message.
-    if (send_message(new_actor_id, (message_t){.message_type = MSG_HELLO, .data = (void *)actor,
-            .nbytes = sizeof(actor_id_t)}) != 0)
-        exit(1);
+    return err;
 }
 
-bool actor_exists(actor_id_t actor) {
-    if (actor < 0)
-        return false;
-    if (pthread_mutex_lock(&actor_system->system_state_mutex) != 0)
+void unregister_system(actor_system_t *system) {
+    if (pthread_mutex_lock(&systems_mutex) != 0)
         exit(1);
 
-    bool exists = actor < (actor_id_t)actor_system->actor_count;
+    for (size_t i = 0; i < ACTOR_MAX_SYSTEMS; ++i) {
+        if (atomic_load(&systems[i]) == system) {
+            atomic_store(&systems[i], NULL);
+            if (--systems_count == 0)
+                reset_signal_operation();
+            break;
+        }
+    }
 
-    if (pthread_mutex_unlock(&actor_system->system_state_mutex) != 0)
+    if (pthread_mutex_unlock(&systems_mutex) != 0)
         exit(1);
-
-    return exists;
 }
 
-int reset_signal_operation() {
-    if (sigaction(SIGINT, &actor_system->old_action, NULL) != 0)
-        return -1;
+bool all_systems_returned() {
+    for (size_t i = 0; i < ACTOR_MAX_SYSTEMS; ++i) {
+        actor_system_t *system = atomic_load(&systems[i]);
+        if (system != NULL && !atomic_load(&system->all_threads_returned))
+            return false;
+    }
 
-    return 0;
+    return true;
 }
 
-void destroy_thread_pool(size_t created_threads_count) {
-    actor_system->all_work_done = true;
+actor_system_t *current_system() {
+    // Handlers send within their own system.
+    return thread_worker != NULL ? thread_worker->system : default_system;
+}
 
-    pthread_cond_broadcast(&actor_system->cond);
+void lock_mutex(__attribute__((unused))actor_system_t *system, pthread_mutex_t *mutex) {
+#ifdef CACTI_METRICS
+    // Clock is read only if the mutex is contended.
+    if (pthread_mutex_trylock(mutex) == 0)
+        return;
 
-    for (size_t i = 0; i < created_threads_count; ++i) {
-        if (pthread_join(actor_system->threads[i], NULL) != 0)
-            exit(1);
-    }
+    unsigned long long start = monotonic_ns();
+#endif
+
+    if (pthread_mutex_lock(mutex) != 0)
+        exit(1);
+
+    METRICS(atomic_fetch_add_explicit(&thread_metrics(system)->lock_wait_ns,
+                                      monotonic_ns() - start, memory_order_relaxed);)
 }
 
-void destroy_actors() {
-    for (size_t i = 0; i < actor_system->actor_count; ++i) {
-        pthread_mutex_destroy(&actor_system->actors[i].mutex);
-        delete_queue(&actor_system->actors[i].message_queue);
-        free(actor_system->actors[i].state);
-        // Deleting state and role is user's responsibility.
-    }
+unsigned long long monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-    free(actor_system->actors);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
 }
 
-void destroy_actor_system() {
-    if (pthread_cond_destroy(&actor_system->cond) != 0)
-        exit(1);
-    if (pthread_mutex_destroy(&actor_system->system_state_mutex) != 0)
-        exit(1);
-    if (pthread_mutex_destroy(&actor_system->actor_queue_mutex) != 0)
-        exit(1);
-    if (pthread_rwlock_destroy(&actor_system->realloc_safety) != 0)
-        exit(1);
+#ifdef CACTI_METRICS
+worker_metrics_t *thread_metrics(actor_system_t *system) {
+    if (thread_worker != NULL && thread_worker->system == system)
+        return &thread_worker->metrics;
 
-    delete_queue(&actor_system->actor_queue);
-    destroy_actors();
-    reset_signal_operation();
+    return &system->external_metrics;
+}
 
-    free(actor_system);
-    actor_system = NULL;
+void copy_worker_metrics(const worker_metrics_t *metrics, actor_worker_stats_t *stats) {
+    stats->messages_processed = atomic_load_explicit(&metrics->processed, memory_order_relaxed);
+    stats->messages_sent = atomic_load_explicit(&metrics->sent, memory_order_relaxed);
+    stats->messages_rejected = atomic_load_explicit(&metrics->rejected, memory_order_relaxed);
+    stats->actor_runs = atomic_load_explicit(&metrics->runs, memory_order_relaxed);
+    stats->steals = atomic_load_explicit(&metrics->steals, memory_order_relaxed);
+    stats->stolen_actors = atomic_load_explicit(&metrics->stolen, memory_order_relaxed);
+    stats->busy_ns = atomic_load_explicit(&metrics->busy_ns, memory_order_relaxed);
+    stats->idle_ns = atomic_load_explicit(&metrics->idle_ns, memory_order_relaxed);
+    stats->lock_wait_ns = atomic_load_explicit(&metrics->lock_wait_ns, memory_order_relaxed);
 }
 
-actor_id_t actor_id_self() {
-    return thread_actor;
+void add_worker_stats(actor_worker_stats_t *total, const actor_worker_stats_t *stats) {
+    total->messages_processed += stats->messages_processed;
+    total->messages_sent += stats->messages_sent;
+    total->messages_rejected += stats->messages_rejected;
+    total->actor_runs += stats->actor_runs;
+    total->steals += stats->steals;
+    total->stolen_actors += stats->stolen_actors;
+    total->busy_ns += stats->busy_ns;
+    total->idle_ns += stats->idle_ns;
+    total->lock_wait_ns += stats->lock_wait_ns;
 }
+#endif
 
-int actor_system_create(actor_id_t *actor, role_t *const role) {
-    if (actor_system != NULL)
-        return -1;
+#ifdef CACTI_TRACE
+void trace(worker_t *worker, enum trace_event_type type, actor_id_t actor, long arg) {
+    size_t head = atomic_load_explicit(&worker->trace_head, memory_order_relaxed);
+    trace_event_t *event = &worker->trace[head % ACTOR_TRACE_EVENTS];
 
-    actor_system = malloc(sizeof(actor_system_t));
-    if (actor_system == NULL)
-        return -1;
+    atomic_store_explicit(&event->ns, monotonic_ns(), memory_order_relaxed);
+    atomic_store_explicit(&event->actor, actor, memory_order_relaxed);
+    atomic_store_explicit(&event->arg, arg, memory_order_relaxed);
+    atomic_store_explicit(&event->type, type, memory_order_relaxed);
 
-    actor_system->actors = malloc(DATA_SIZE * sizeof(actor_properties_t));
-    if (actor_system->actors == NULL)
-        goto ACTORS_ERROR;
+    atomic_store_explicit(&worker->trace_head, head + 1, memory_order_release);
+}
 
-    actor_system->dead_count = 0;
-    actor_system->actor_count = 0;
-    actor_system->actors_capacity = DATA_SIZE;
-    actor_system->all_work_done = false;
-    actor_system->interrupted = false;
-    actor_system->all_threads_returned = false;
-    actor_system->returned_threads = 0;
+void write_trace_events(actor_system_t *system, size_t index, FILE *file, bool *first) {
+    worker_t *worker = &system->workers[index];
+
+    size_t head = atomic_load_explicit(&worker->trace_head, memory_order_acquire);
+    size_t begin = head > ACTOR_TRACE_EVENTS ? head - ACTOR_TRACE_EVENTS : 0;
+
+    fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,"
+                  "\"args\":{\"name\":\"worker %zu\"}}", *first ? "" : ",", index, index);
+    *first = false;
+
+    for (size_t i = begin; i < head; ++i) {
+        trace_event_t *event = &worker->trace[i % ACTOR_TRACE_EVENTS];
+        unsigned long long ns = atomic_load_explicit(&event->ns, memory_order_relaxed);
+        actor_id_t actor = atomic_load_explicit(&event->actor, memory_order_relaxed);
+        long arg = atomic_load_explicit(&event->arg, memory_order_relaxed);
+        int type = atomic_load_explicit(&event->type, memory_order_relaxed);
+
+        // Events older than the system were overwritten while the trace was written.
+        if (ns < system->trace_start_ns)
+            continue;
+
+        double ts = (double)(ns - system->trace_start_ns) / 1000.0;
+        fprintf(file, ",\n{\"pid\":1,\"tid\":%zu,\"ts\":%.3f,", index, ts);
+
+        switch (type) {
+            case TRACE_HANDLER_BEGIN:
+            case TRACE_HANDLER_END:
+                fprintf(file, "\"ph\":\"%s\",\"name\":\"message %ld\","
+                              "\"args\":{\"actor\":%ld,\"type\":%ld}}",
+                        type == TRACE_HANDLER_BEGIN ? "B" : "E", arg, actor, arg);
+                break;
+            case TRACE_SPAWN:
+                fprintf(file, "\"ph\":\"i\",\"s\":\"t\",\"name\":\"spawn\","
+                              "\"args\":{\"actor\":%ld,\"parent\":%ld}}", actor, arg);
+                break;
+            case TRACE_GODIE:
+                fprintf(file, "\"ph\":\"i\",\"s\":\"t\",\"name\":\"go_die\","
+                              "\"args\":{\"actor\":%ld}}", actor);
+                break;
+            case TRACE_STEAL:
+                fprintf(file, "\"ph\":\"i\",\"s\":\"t\",\"name\":\"steal\","
+                              "\"args\":{\"actor\":%ld,\"count\":%ld}}", actor, arg);
+                break;
+            default:
+                fprintf(file, "\"ph\":\"%s\",\"name\":\"parked\"}",
+                        type == TRACE_PARK ? "B" : "E");
+                break;
+        }
+    }
+}
+#endif
 
-    if (create_queue(&actor_system->actor_queue) != 0)
-        goto ACTOR_QUEUE_ERROR;
+#ifdef CACTI_LATENCY
+latency_entry_t *latency_entry(worker_t *worker, act_t *prompts, message_type_t message_type) {
+    size_t hash = ((uintptr_t)prompts / sizeof(act_t) * 31 + (size_t)message_type) %
+            ACTOR_LATENCY_KEYS;
 
-    if (pthread_mutex_init(&actor_system->actor_queue_mutex, 0) != 0)
-        goto MUTEX_ERROR;
+    for (size_t i = 0; i < ACTOR_LATENCY_KEYS; ++i) {
+        _Atomic(latency_entry_t *) *slot = &worker->latency[(hash + i) % ACTOR_LATENCY_KEYS];
+        latency_entry_t *entry = atomic_load_explicit(slot, memory_order_relaxed);
 
-    if (pthread_mutex_init(&actor_system->system_state_mutex, 0) != 0)
-        goto STATE_MUTEX_ERROR;
+        if (entry == NULL) {
+            entry = create_latency_entry(prompts, message_type);
+            if (entry == NULL)
+                return NULL;
 
-    if (pthread_cond_init(&actor_system->cond, 0) != 0)
-        goto COND_ERROR;
+            // Readers see initialized histograms.
+            atomic_store_explicit(slot, entry, memory_order_release);
+            return entry;
+        }
 
-    if (create_thread_pool() != 0)
-        goto THREADS_ERROR;
+        if (entry->prompts == prompts && entry->message_type == message_type)
+            return entry;
+    }
 
-    if (set_signal_operation() != 0)
-        goto SET_SIGNAL_ERROR;
+    return NULL;
+}
 
-    if (pthread_rwlock_init(&actor_system->realloc_safety, NULL) != 0)
-        goto RW_LOCK_ERROR;
+latency_entry_t *create_latency_entry(act_t *prompts, message_type_t message_type) {
+    latency_entry_t *entry = malloc(sizeof(latency_entry_t));
+    if (entry == NULL)
+        return NULL;
 
-    *actor = 0;
-    if (create_actor(0, role) != 0)
-        goto NEW_ACTOR_ERROR;
+    entry->prompts = prompts;
+    entry->message_type = message_type;
+    create_histogram(&entry->queue_ns);
+    create_histogram(&entry->handler_ns);
 
-    send_message(*actor, (message_t){.message_type = MSG_HELLO,
-            .nbytes = 0, .data = NULL});
+    return entry;
+}
 
-    return 0;
+void print_latency_entry(int fd, const char *prefix, const latency_entry_t *entry) {
+    const histogram_t *histograms[2] = {&entry->queue_ns, &entry->handler_ns};
+    const char *names[2] = {"queue_ns", "handler_ns"};
 
-    NEW_ACTOR_ERROR:
-    if (pthread_rwlock_destroy(&actor_system->realloc_safety) != 0)
-        exit(1);
-    RW_LOCK_ERROR:
-        reset_signal_operation();
-    SET_SIGNAL_ERROR:
-        destroy_thread_pool(POOL_SIZE);
-    THREADS_ERROR:
-        if (pthread_cond_destroy(&actor_system->cond) != 0)
-            exit(1);
-    COND_ERROR:
-        if (pthread_mutex_destroy(&actor_system->system_state_mutex) != 0)
-            exit(1);
-    STATE_MUTEX_ERROR:
-        if (pthread_mutex_destroy(&actor_system->actor_queue_mutex) != 0)
-            exit(1);
-    MUTEX_ERROR:
-        delete_queue(&actor_system->actor_queue);
-    ACTOR_QUEUE_ERROR:
-        free(actor_system->actors);
-        actor_system->actors = NULL;
-    ACTORS_ERROR:
-        free(actor_system);
-        actor_system = NULL;
-        return -1;
+    dprintf(fd, "%s role %p type %ld", prefix, (void *)entry->prompts, entry->message_type);
+    for (size_t i = 0; i < 2; ++i) {
+        dprintf(fd, " %s count %llu p50 %llu p90 %llu p99 %llu p999 %llu max %llu", names[i],
+                histogram_count(histograms[i]), histogram_percentile(histograms[i], 50),
+                histogram_percentile(histograms[i], 90), histogram_percentile(histograms[i], 99),
+                histogram_percentile(histograms[i], 99.9), histogram_max(histograms[i]));
+    }
+    dprintf(fd, "\n");
 }
 
-void actor_system_join(actor_id_t actor) {
-    if (actor_system == NULL || !actor_exists(actor))
-        return;
+void request_latency_dump(__attribute__((unused))int sig) {
+    for (size_t i = 0; i < ACTOR_MAX_SYSTEMS; ++i) {
+        actor_system_t *system = atomic_load(&systems[i]);
+        if (system != NULL) {
+            atomic_store(&system->latency_dump, true);
+            pthread_cond_broadcast(&system->cond);
+        }
+    }
+}
+#endif
 
-    pthread_t threads[POOL_SIZE];
-    memcpy(threads, actor_system->threads, POOL_SIZE * sizeof(pthread_t));
-    for (int i = 0; i < POOL_SIZE; ++i) {
-        if (pthread_join(threads[i], NULL) != 0)
-            exit(1);
+void block_system(__attribute__((unused))int sig) {
+    for (size_t i = 0; i < ACTOR_MAX_SYSTEMS; ++i) {
+        actor_system_t *system = atomic_load(&systems[i]);
+        if (system != NULL) {
+            system->interrupted = true;
+            pthread_cond_broadcast(&system->cond);
+            pthread_cond_broadcast(&system->spare_cond);
+        }
     }
 
-    if (!actor_system->interrupted)
-        destroy_actor_system();
+    if (all_systems_returned()) {
+        reset_signal_operation();
+        raise(SIGINT);
+    }
 }
 
-int send_message(actor_id_t actor, message_t message) {
-    if (actor_system == NULL || !actor_exists(actor))
-        return -2;
+int set_signal_operation() {
+    struct sigaction new_action;
+    sigset_t block_mask;
 
-    // Create message.
-    message_t *new_mess = malloc(sizeof(message_t));
-    if (new_mess == NULL)
-        exit(1);
+    sigemptyset(&block_mask);
 
-    new_mess->message_type = message.message_type;
-    new_mess->data = message.data;
-    new_mess->nbytes = message.nbytes;
+    new_action.sa_handler = block_system;
+    new_action.sa_mask = block_mask;
+    new_action.sa_flags = SA_RESTART;
 
-    // Accessing actors cannot be done during reallocation.
-    if (pthread_rwlock_rdlock(&actor_system->realloc_safety) != 0)
-        exit(1);
+    if (sigaction(SIGINT, &new_action, &old_action) != 0)
+        return -1;
 
-    // Check if given actor is dead or its message queue is full.
-    if (pthread_mutex_lock(&actor_system->actors[actor].mutex) != 0)
+#ifdef CACTI_LATENCY
+    new_action.sa_handler = request_latency_dump;
+    if (sigaction(SIGUSR1, &new_action, &old_dump_action) != 0) {
+        sigaction(SIGINT, &old_action, NULL);
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+int create_timers(actor_system_t *system) {
+    pthread_condattr_t attr;
+
+    if (pthread_mutex_init(&system->timer_mutex, 0) != 0)
+        return -1;
+
+    // Timer thread waits for ticks of the monotonic clock.
+    if (pthread_condattr_init(&attr) != 0)
+        goto ATTR_ERROR;
+    if (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0 ||
+        pthread_cond_init(&system->timer_cond, &attr) != 0) {
+        pthread_condattr_destroy(&attr);
+        goto ATTR_ERROR;
+    }
+    pthread_condattr_destroy(&attr);
+
+    if (create_queue(&system->free_timers) != 0)
+        goto QUEUE_ERROR;
+
+    system->timer_thread_started = false;
+    system->timer_thread_stopped = false;
+    system->timer_chunks = NULL;
+    system->timer_chunk_count = 0;
+    system->timer_slot_count = 0;
+    create_timer_wheel(&system->timer_wheel, current_tick());
+
+    return 0;
+
+    QUEUE_ERROR:
+        pthread_cond_destroy(&system->timer_cond);
+    ATTR_ERROR:
+        pthread_mutex_destroy(&system->timer_mutex);
+        return -1;
+}
+
+void destroy_timers(actor_system_t *system) {
+    if (system->timer_thread_started) {
+        if (pthread_mutex_lock(&system->timer_mutex) != 0)
+            exit(1);
+        system->timer_thread_stopped = true;
+        if (pthread_cond_signal(&system->timer_cond) != 0)
+            exit(1);
+        if (pthread_mutex_unlock(&system->timer_mutex) != 0)
+            exit(1);
+
+        if (pthread_join(system->timer_thread, NULL) != 0)
+            exit(1);
+    }
+
+    // Messages of timers which did not fire are not freed, as those of unsent messages.
+    for (size_t i = 0; i < system->timer_chunk_count; ++i)
+        free(system->timer_chunks[i]);
+    free(system->timer_chunks);
+    delete_queue(&system->free_timers);
+
+    if (pthread_cond_destroy(&system->timer_cond) != 0)
+        exit(1);
+    if (pthread_mutex_destroy(&system->timer_mutex) != 0)
+        exit(1);
+}
+
+unsigned long long current_tick() {
+    return monotonic_ns() / NS_PER_TICK;
+}
+
+timer_entry_t *get_timer(actor_system_t *system, size_t index) {
+    return &system->timer_chunks[index / ACTOR_TIMER_CHUNK_SIZE][index % ACTOR_TIMER_CHUNK_SIZE];
+}
+
+timer_entry_t *acquire_timer(actor_system_t *system) {
+    if (!empty(&system->free_timers))
+        return get_timer(system, (size_t)pop(&system->free_timers));
+
+    if (system->timer_slot_count == ACTOR_INDEX_MASK)
+        return NULL;
+
+    if (system->timer_slot_count == system->timer_chunk_count * ACTOR_TIMER_CHUNK_SIZE) {
+        timer_entry_t **chunks = realloc(system->timer_chunks,
+                                         (system->timer_chunk_count + 1) * sizeof(timer_entry_t *));
+        if (chunks == NULL)
+            return NULL;
+        system->timer_chunks = chunks;
+
+        chunks[system->timer_chunk_count] = malloc(ACTOR_TIMER_CHUNK_SIZE * sizeof(timer_entry_t));
+        if (chunks[system->timer_chunk_count] == NULL)
+            return NULL;
+        ++system->timer_chunk_count;
+    }
+
+    timer_entry_t *timer = get_timer(system, system->timer_slot_count);
+    timer->index = system->timer_slot_count++;
+    timer->generation = 0;
+    timer->active = false;
+
+    return timer;
+}
+
+void release_timer(actor_system_t *system, timer_entry_t *timer) {
+    timer->active = false;
+    timer->generation = (timer->generation + 1) % ACTOR_TIMER_GENERATIONS;
+
+    if (push(&system->free_timers, (void *)timer->index) != 0)
+        exit(1);
+}
+
+int add_timer(actor_system_t *system, actor_id_t actor, message_t message,
+              unsigned long long delay, unsigned long long period, actor_timer_t *timer) {
+    if (system == NULL || !actor_exists(system, actor))
+        return -2;
+
+    lock_mutex(system, &system->timer_mutex);
+
+    // Thread is started lazily, so systems without timers do not pay for it.
+    if (!system->timer_thread_started) {
+        if (pthread_create(&system->timer_thread, NULL, timer_thread, system) != 0)
+            goto ERROR;
+        system->timer_thread_started = true;
+    }
+
+    timer_entry_t *entry = acquire_timer(system);
+    if (entry == NULL)
+        goto ERROR;
+
+    entry->actor = actor;
+    entry->message = message;
+    entry->period = period;
+    entry->active = true;
+
+    // Empty wheel may be behind, as its thread does not tick.
+    unsigned long long now = current_tick();
+    if (timer_wheel_empty(&system->timer_wheel))
+        timer_wheel_advance(&system->timer_wheel, now);
+
+    entry->node.expires = now + delay;
+    timer_wheel_add(&system->timer_wheel, &entry->node);
+
+    if (timer != NULL)
+        *timer = (actor_timer_t)((entry->generation << 32) | entry->index);
+
+    // The new timer may be nearer than the one the thread waits for.
+    if (pthread_cond_signal(&system->timer_cond) != 0)
+        exit(1);
+    if (pthread_mutex_unlock(&system->timer_mutex) != 0)
         exit(1);
 
-    size_t q_size = get_size(&actor_system->actors[actor].message_queue);
+    return 0;
 
-    bool dead = actor_system->interrupted || actor_system->actors[actor].is_dead;
-    if (dead || q_size == ACTOR_QUEUE_LIMIT) {
-        if (pthread_mutex_unlock(&actor_system->actors[actor].mutex) != 0)
+    ERROR:
+        if (pthread_mutex_unlock(&system->timer_mutex) != 0)
             exit(1);
-        if (pthread_rwlock_unlock(&actor_system->realloc_safety) != 0)
+        return -1;
+}
+
+void fire_timers(actor_system_t *system, wheel_timer_t *expired) {
+    while (expired != NULL) {
+        timer_entry_t *entry = (timer_entry_t *)expired;
+        expired = expired->next;
+
+        int result = send_message_to(system, entry->actor, entry->message);
+
+        // Message which does not fit is sent in the next tick.
+        if (result == -3 || (result == 0 && entry->period > 0)) {
+            entry->node.expires = result == -3 ? system->timer_wheel.now + 1 :
+                    entry->node.expires + entry->period;
+            timer_wheel_add(&system->timer_wheel, &entry->node);
+            continue;
+        }
+
+        release_timer(system, entry);
+    }
+}
+
+void *timer_thread(void *data) {
+    actor_system_t *system = data;
+
+    if (pthread_mutex_lock(&system->timer_mutex) != 0)
+        exit(1);
+
+    while (!system->timer_thread_stopped) {
+        if (timer_wheel_empty(&system->timer_wheel)) {
+            if (pthread_cond_wait(&system->timer_cond, &system->timer_mutex) != 0)
+                exit(1);
+            continue;
+        }
+
+        // Thread sleeps until something happens in the wheel. Nearer timers added meanwhile
+        // wake it up.
+        unsigned long long next_ns = timer_wheel_next(&system->timer_wheel) * NS_PER_TICK;
+        struct timespec deadline = {.tv_sec = (time_t)(next_ns / 1000000000ULL),
+                                    .tv_nsec = (long)(next_ns % 1000000000ULL)};
+        int err = pthread_cond_timedwait(&system->timer_cond, &system->timer_mutex, &deadline);
+        if (err != 0 && err != ETIMEDOUT)
             exit(1);
-        free(new_mess);
-        if (dead)
-            return -1;
-        else
-            return -3;
+
+        fire_timers(system, timer_wheel_advance(&system->timer_wheel, current_tick()));
     }
 
-    if (push(&actor_system->actors[actor].message_queue, new_mess) != 0) {
-        if (pthread_mutex_unlock(&actor_system->actors[actor].mutex) != 0)
+    if (pthread_mutex_unlock(&system->timer_mutex) != 0)
+        exit(1);
+
+    return NULL;
+}
+
+void *worker (void *data) {
+    actor_id_t current_actor;
+    bool finished = false;
+
+    thread_worker = (worker_t *)data;
+    actor_system_t *system = thread_worker->system;
+
+    METRICS(
+        worker_metrics_t *metrics = &thread_worker->metrics;
+        unsigned long long idle_start = monotonic_ns();
+    )
+
+    while (!finished) {
+        LATENCY(
+            if (atomic_load_explicit(&system->latency_dump, memory_order_relaxed) &&
+                atomic_exchange(&system->latency_dump, false))
+                actor_system_latency_print(system, STDERR_FILENO);
+        )
+
+        if (thread_worker->index >= system->pool_size && !spare_needed(thread_worker)) {
+            finished = !park_spare(thread_worker);
+            continue;
+        }
+
+        if (find_actor(thread_worker, &current_actor)) {
+            METRICS(
+                unsigned long long busy_start = monotonic_ns();
+                atomic_fetch_add_explicit(&metrics->idle_ns, busy_start - idle_start,
+                                          memory_order_relaxed);
+                atomic_fetch_add_explicit(&metrics->runs, 1, memory_order_relaxed);
+            )
+
+            work_with_actor(system, current_actor);
+
+            METRICS(
+                idle_start = monotonic_ns();
+                atomic_fetch_add_explicit(&metrics->busy_ns, idle_start - busy_start,
+                                          memory_order_relaxed);
+            )
+            continue;
+        }
+
+        if (pthread_mutex_lock(&system->idle_mutex) != 0)
             exit(1);
-        if (pthread_rwlock_unlock(&actor_system->realloc_safety) != 0)
+
+        // Worker is counted before it checks ready queues for the last time, so a scheduler
+        // which does not see it in [sleepers] pushed its actor before the check.
+        atomic_fetch_add(&system->sleepers, 1);
+        TRACE(trace(thread_worker, TRACE_PARK, 0, 0);)
+
+        while (!system->interrupted && !system->all_work_done && !work_available(system) &&
+               !LATENCY_DUMP_REQUESTED(system)) {
+            if (pthread_cond_wait(&system->cond, &system->idle_mutex) != 0)
+                exit(1);
+        }
+
+        atomic_fetch_sub(&system->sleepers, 1);
+        TRACE(trace(thread_worker, TRACE_UNPARK, 0, 0);)
+
+        // If all actors are dead and no more messages stayed at any actor's queue.
+        finished = (system->all_work_done || system->interrupted) && !work_available(system);
+
+        if (pthread_mutex_unlock(&system->idle_mutex) != 0)
             exit(1);
-        free(new_mess);
-        return -1;
     }
 
-    if (pthread_mutex_unlock(&actor_system->actors[actor].mutex) != 0)
+    if (pthread_mutex_lock(&system->system_state_mutex) != 0)
+        exit(1);
+
+    system->returned_threads++;
+    bool all_threads_returned = system->returned_threads == atomic_load(&system->worker_count);
+    atomic_store(&system->all_threads_returned, all_threads_returned);
+
+    if (pthread_mutex_unlock(&system->system_state_mutex) != 0)
+        exit(1);
+
+    // If all threads of all systems returned and they were interrupted by SIGINT,
+    // program has to be killed.
+    if (all_threads_returned && system->interrupted && all_systems_returned()) {
+        reset_signal_operation();
+        raise(SIGINT);
+    }
+
+    return NULL;
+}
+
+bool spare_needed(worker_t *worker) {
+    actor_system_t *system = worker->system;
+
+    return worker->index - system->pool_size < atomic_load(&system->blocked);
+}
+
+bool park_spare(worker_t *worker) {
+    actor_system_t *system = worker->system;
+    worker_t *heir = &system->workers[worker->index % system->pool_size];
+
+    // Only the spare itself pushes to its queues, so they stay empty while it is parked.
+    // Workers of the pool never lock other queues while holding their own one.
+    lock_mutex(system, &worker->actor_queue_mutex);
+    lock_mutex(system, &heir->actor_queue_mutex);
+
+    for (size_t i = 0; i < ACTOR_PRIORITIES; ++i) {
+        while (!empty(&worker->actor_queues[i])) {
+            if (push(&heir->actor_queues[i], pop(&worker->actor_queues[i])) != 0)
+                exit(1);
+        }
+    }
+
+    if (pthread_mutex_unlock(&heir->actor_queue_mutex) != 0 ||
+        pthread_mutex_unlock(&worker->actor_queue_mutex) != 0)
+        exit(1);
+
+    if (pthread_mutex_lock(&system->idle_mutex) != 0)
         exit(1);
 
-    if (pthread_rwlock_unlock(&actor_system->realloc_safety) != 0)
+    // Moved actors, or the one the spare was woken for, are left for sleeping workers.
+    if (atomic_load(&system->sleepers) > 0 && pthread_cond_broadcast(&system->cond) != 0)
         exit(1);
 
-    // If queue was empty, actor information needs to be pushed into actors queue.
-    if (q_size == 0) {
-        if (pthread_mutex_lock(&actor_system->actor_queue_mutex) != 0)
+    TRACE(trace(worker, TRACE_PARK, 0, 0);)
+
+    while (!system->interrupted && !system->all_work_done && !spare_needed(worker)) {
+        if (pthread_cond_wait(&system->spare_cond, &system->idle_mutex) != 0)
             exit(1);
+    }
+
+    TRACE(trace(worker, TRACE_UNPARK, 0, 0);)
+
+    bool needed = !system->interrupted && !system->all_work_done;
 
-        actor_id_t *actor_id = malloc(sizeof(actor_id_t));
-        *actor_id = actor;
-        if (push(&actor_system->actor_queue, actor_id) != 0)
+    if (pthread_mutex_unlock(&system->idle_mutex) != 0)
+        exit(1);
+
+    return needed;
+}
+
+bool find_actor(worker_t *worker, actor_id_t *actor) {
+    actor_system_t *system = worker->system;
+
+    for (size_t i = 0; ; ++i) {
+        size_t lane;
+        if (pop_local_actor(worker, actor, &lane) || steal_actors(worker, actor, &lane)) {
+            // Actor promoted to a higher lane is left there in the lower one too.
+            if (claim_actor(system, *actor, lane))
+                return true;
+            continue;
+        }
+
+        // Waking up a parked worker takes much longer than a short wait for the next message.
+        if (i < system->idle_spins)
+            CPU_RELAX();
+        else if (i < system->idle_spins + system->idle_yields)
+            sched_yield();
+        else
+            return false;
+    }
+}
+
+void work_with_actor(actor_system_t *system, actor_id_t actor) {
+    thread_actor = actor;
+
+    actor_properties_t *properties = get_actor(system, actor);
+    message_queue_t *queue = &properties->message_queue;
+
+    struct timespec batch_start;
+    if (ACTOR_TIME_BUDGET > 0)
+        clock_gettime(CLOCK_MONOTONIC, &batch_start);
+
+    for (size_t handled = 1; ; ++handled) {
+        // Scheduled actor has a message, but its sender might not have linked it yet.
+        mailbox_node_t *node;
+        while ((node = pop_message(properties)) == NULL)
+            sched_yield();
+
+        // Messages which are known to be in the mailbox apart from the current one.
+        size_t remaining = (atomic_fetch_sub(&queue->state, 1) - 1) & ACTOR_MESSAGES;
+
+        METRICS(
+            atomic_fetch_add_explicit(&properties->metrics.processed, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&thread_worker->metrics.processed, 1, memory_order_relaxed);
+        )
+
+        message_t *current_message = &((envelope_t *)node)->message;
+
+        LATENCY(
+            unsigned long long handler_start = monotonic_ns();
+            latency_entry_t *latency = latency_entry(thread_worker, properties->role.prompts,
+                                                     current_message->message_type);
+        )
+
+        TRACE(trace(thread_worker, TRACE_HANDLER_BEGIN, actor, current_message->message_type);)
+
+        if (current_message->message_type == MSG_GODIE) {
+            TRACE(trace(thread_worker, TRACE_GODIE, actor, 0);)
+            go_die(queue);
+        }
+        else if (current_message->message_type == MSG_SPAWN) {
+            spawn(system, *current_message, actor);
+        }
+        // Given message type may not be defined for this actor.
+        else if ((size_t)current_message->message_type < properties->role.nprompts) {
+            act_t service = properties->role.prompts[current_message->message_type];
+            thread_envelope = (envelope_t *)node;
+            service(&properties->state, current_message->nbytes, current_message->data);
+            thread_envelope = NULL;
+        }
+
+        TRACE(trace(thread_worker, TRACE_HANDLER_END, actor, current_message->message_type);)
+
+        LATENCY(
+            if (latency != NULL) {
+                histogram_record(&latency->queue_ns,
+                                 handler_start - ((envelope_t *)node)->sent_ns);
+                histogram_record(&latency->handler_ns, monotonic_ns() - handler_start);
+            }
+        )
+
+        release_envelope((envelope_t *)node);
+
+        if (remaining == 0) {
+            // Lanes asked for by senders of handled messages are forgotten, so they do not
+            // promote the actor when it is woken again. Later requests are made after
+            // their messages are linked, so they are kept or the messages are seen when
+            // the actor is requeued.
+            uint64_t running = ((uint64_t)actor & ACTOR_GENERATION) |
+                               ACTOR_READY_RUNNING(ACTOR_PRIORITIES);
+            if (atomic_load_explicit(&queue->ready, memory_order_relaxed) != running)
+                atomic_store(&queue->ready, running);
+
+            // Actor with more messages stays scheduled, so senders do not push it again.
+            // Slot of a dead actor gets the next generation, which makes its identifier stale.
+            uint64_t state = atomic_load(&queue->state);
+            uint64_t idle_state;
+            do {
+                remaining = state & ACTOR_MESSAGES;
+                if ((state & ACTOR_DEAD) != 0)
+                    idle_state = ACTOR_DEAD | ACTOR_NEXT_GENERATION(state);
+                else
+                    idle_state = state & ~ACTOR_SCHEDULED;
+            } while (remaining == 0 &&
+                     !atomic_compare_exchange_weak(&queue->state, &state, idle_state));
+
+            if (remaining == 0) {
+                if ((state & ACTOR_DEAD) != 0)
+                    release_actor(system, actor);
+                return;
+            }
+        }
+
+        // Actor used up its quantum, so other ready actors go first. Senders of messages
+        // which are not linked yet may have asked for a higher lane.
+        if (handled == system->throughput ||
+            (ACTOR_TIME_BUDGET > 0 && elapsed_microseconds(&batch_start) >= ACTOR_TIME_BUDGET)) {
+            uint64_t generation = (uint64_t)actor & ACTOR_GENERATION;
+            size_t lane = waiting_priority(properties);
+            uint64_t ready = atomic_load(&queue->ready);
+            size_t wanted;
+            do {
+                wanted = ACTOR_READY_PLACE(ready) - ACTOR_READY_RUNNING(0);
+                if (wanted < lane)
+                    lane = wanted;
+            } while (!atomic_compare_exchange_weak(&queue->ready, &ready,
+                                                   generation | ACTOR_READY_QUEUED(lane)));
+
+            schedule_actor(system, actor, (actor_priority_t)lane);
+            return;
+        }
+    }
+}
+
+size_t first_lane(size_t turn) {
+    if (turn % ACTOR_PRIORITY_STARVATION != ACTOR_PRIORITY_STARVATION - 1)
+        return 0;
+
+    // Lower lanes get their turns one after another.
+    return 1 + turn / ACTOR_PRIORITY_STARVATION % (ACTOR_PRIORITIES - 1);
+}
+
+mailbox_node_t *pop_message(actor_properties_t *properties) {
+    size_t first = first_lane(properties->turn++);
+
+    for (size_t i = 0; i < ACTOR_PRIORITIES; ++i) {
+        mailbox_node_t *node = mailbox_pop(
+                &properties->message_queue.mailboxes[(first + i) % ACTOR_PRIORITIES]);
+        if (node != NULL)
+            return node;
+    }
+
+    return NULL;
+}
+
+actor_priority_t waiting_priority(actor_properties_t *properties) {
+    for (size_t i = 0; i < ACTOR_PRIORITIES; ++i) {
+        if (!mailbox_empty(&properties->message_queue.mailboxes[i]))
+            return (actor_priority_t)i;
+    }
+
+    // Remaining messages are still being pushed.
+    return ACTOR_PRIORITY_NORMAL;
+}
+
+long elapsed_microseconds(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - since->tv_sec) * 1000000L + (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+envelope_t *create_envelopes(actor_system_t *system, size_t count) {
+    slab_pool_t *pool = &system->external_pool;
+    bool external = thread_worker == NULL || thread_worker->system != system;
+
+    // Envelopes never leave their system, so they do not outlive their pools.
+    if (!external)
+        pool = &thread_worker->envelope_pool;
+    else
+        lock_mutex(system, &system->external_pool_mutex);
+
+    LATENCY(unsigned long long now = monotonic_ns();)
+
+    envelope_t *first = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        envelope_t *envelope = slab_alloc(pool);
+        if (envelope == NULL)
             exit(1);
 
-        if (pthread_mutex_unlock(&actor_system->actor_queue_mutex) != 0)
+        LATENCY(envelope->sent_ns = now;)
+
+        atomic_store_explicit(&envelope->node.next, (mailbox_node_t *)first, memory_order_relaxed);
+        envelope->owns_data = false;
+        envelope->reply.future = NULL;
+        envelope->reply.actor = -1;
+        first = envelope;
+    }
+
+    if (external && pthread_mutex_unlock(&system->external_pool_mutex) != 0)
+        exit(1);
+
+    return first;
+}
+
+void release_envelope(envelope_t *envelope) {
+    if (envelope->owns_data)
+        free(envelope->message.data);
+    if (envelope->reply.future != NULL)
+        complete_future(envelope->reply.future, NULL);
+
+    // Outside of the thread pool envelopes are always returned as if by another thread,
+    // so [external_pool_mutex] is not needed.
+    slab_free(thread_worker != NULL ? &thread_worker->envelope_pool : NULL, envelope);
+}
+
+void release_envelopes(envelope_t *first) {
+    while (first != NULL) {
+        envelope_t *next = (envelope_t *)atomic_load_explicit(&first->node.next,
+                                                               memory_order_relaxed);
+        release_envelope(first);
+        first = next;
+    }
+}
+
+actor_future_t *create_future() {
+    actor_future_t *future = malloc(sizeof(actor_future_t));
+    if (future == NULL)
+        exit(1);
+
+    if (pthread_mutex_init(&future->mutex, 0) != 0 || pthread_cond_init(&future->cond, 0) != 0)
+        exit(1);
+    atomic_init(&future->state, FUTURE_PENDING);
+    atomic_init(&future->references, 2);
+
+    return future;
+}
+
+void complete_future(actor_future_t *future, const message_t *reply) {
+    if (pthread_mutex_lock(&future->mutex) != 0)
+        exit(1);
+
+    if (reply != NULL)
+        future->reply = *reply;
+    atomic_store(&future->state, reply != NULL ? FUTURE_REPLIED : FUTURE_BROKEN);
+
+    if (pthread_cond_broadcast(&future->cond) != 0)
+        exit(1);
+    if (pthread_mutex_unlock(&future->mutex) != 0)
+        exit(1);
+
+    release_future(future);
+}
+
+void release_future(actor_future_t *future) {
+    if (atomic_fetch_sub(&future->references, 1) != 1)
+        return;
+
+    if (pthread_cond_destroy(&future->cond) != 0 || pthread_mutex_destroy(&future->mutex) != 0)
+        exit(1);
+    free(future);
+}
+
+int send_request(actor_system_t *system, actor_id_t actor, message_t message,
+                 actor_reply_t route) {
+    envelope_t *envelope = create_envelopes(system, 1);
+    envelope->message = message;
+    envelope->reply = route;
+
+    return send_envelopes(system, actor, envelope, envelope, 1, ACTOR_PRIORITY_NORMAL);
+}
+
+int reserve_messages(actor_system_t *system, actor_id_t actor, size_t count) {
+    actor_properties_t *properties = get_actor(system, actor);
+    message_queue_t *queue = &properties->message_queue;
+
+    // Actor's slot may already belong to a newer actor.
+    // Sender of the first message to an idle actor becomes responsible for scheduling it.
+    uint64_t generation = (uint64_t)actor & ~ACTOR_INDEX_MASK;
+    uint64_t state = atomic_load(&queue->state);
+    do {
+        if (system->interrupted || (state & ACTOR_DEAD) != 0 ||
+            (state & ACTOR_GENERATION) != generation)
+            return -1;
+        if ((state & ACTOR_MESSAGES) + count > system->queue_limit) {
+            METRICS(
+                atomic_fetch_add_explicit(&properties->metrics.rejected, count,
+                                          memory_order_relaxed);
+                atomic_fetch_add_explicit(&thread_metrics(system)->rejected, count,
+                                          memory_order_relaxed);
+            )
+            return -3;
+        }
+    } while (!atomic_compare_exchange_weak(&queue->state, &state,
+                                           (state + count) | ACTOR_SCHEDULED));
+
+    METRICS(
+        atomic_fetch_add_explicit(&thread_metrics(system)->sent, count, memory_order_relaxed);
+
+        // Maximum is raised rarely, so it is read first.
+        size_t queued = (state & ACTOR_MESSAGES) + count;
+        size_t high_water = atomic_load_explicit(&properties->metrics.high_water,
+                                                 memory_order_relaxed);
+        while (queued > high_water &&
+               !atomic_compare_exchange_weak_explicit(&properties->metrics.high_water,
+                                                      &high_water, queued,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed));
+    )
+
+    return (state & ACTOR_SCHEDULED) == 0 ? 1 : 0;
+}
+
+void schedule_actor(actor_system_t *system, actor_id_t actor, actor_priority_t priority) {
+    schedule_actors(system, &actor, 1, priority);
+}
+
+void schedule_actors(actor_system_t *system, const actor_id_t *actors, size_t count,
+                     actor_priority_t priority) {
+    worker_t *w = thread_worker;
+    if (w == NULL || w->system != system)
+        w = &system->workers[atomic_fetch_add(&system->next_worker, 1) % system->pool_size];
+
+    lock_mutex(system, &w->actor_queue_mutex);
+
+    // Identifiers are stored in the queue directly.
+    for (size_t i = 0; i < count; ++i) {
+        if (push(&w->actor_queues[priority], (void *)actors[i]) != 0)
             exit(1);
+    }
 
-        if (pthread_cond_signal(&actor_system->cond) != 0)
+    if (pthread_mutex_unlock(&w->actor_queue_mutex) != 0)
+        exit(1);
+
+    // Busy workers and the spinning ones find the actors themselves.
+    if (atomic_load(&system->sleepers) == 0)
+        return;
+
+    // Signalling under [idle_mutex] guarantees that a worker which has just found no work
+    // is already waiting on [cond]. Woken workers steal the actors they need.
+    if (pthread_mutex_lock(&system->idle_mutex) != 0)
+        exit(1);
+
+    size_t sleepers = atomic_load(&system->sleepers);
+    if (count >= sleepers) {
+        if (sleepers > 0 && pthread_cond_broadcast(&system->cond) != 0)
             exit(1);
     }
+    else {
+        for (size_t i = 0; i < count; ++i) {
+            if (pthread_cond_signal(&system->cond) != 0)
+                exit(1);
+        }
+    }
 
-    return 0;
+    if (pthread_mutex_unlock(&system->idle_mutex) != 0)
+        exit(1);
+}
+
+actor_priority_t mark_actor_queued(actor_system_t *system, actor_id_t actor,
+                                   actor_priority_t priority) {
+    message_queue_t *queue = &get_actor(system, actor)->message_queue;
+    uint64_t generation = (uint64_t)actor & ACTOR_GENERATION;
+    uint64_t ready = atomic_load(&queue->ready);
+
+    // Senders of messages reserved after the wake up may ask for a higher lane before
+    // the actor is queued. Identifiers left in other lanes by earlier promotions may be
+    // popped as soon as the place is set.
+    actor_priority_t lane;
+    do {
+        lane = priority;
+        if ((ready & ACTOR_GENERATION) == generation &&
+            ACTOR_READY_PLACE(ready) >= ACTOR_READY_RUNNING(0) &&
+            ACTOR_READY_PLACE(ready) < ACTOR_READY_RUNNING(priority))
+            lane = (actor_priority_t)(ACTOR_READY_PLACE(ready) - ACTOR_READY_RUNNING(0));
+    } while (!atomic_compare_exchange_weak(&queue->ready, &ready,
+                                           generation | ACTOR_READY_QUEUED(lane)));
+
+    return lane;
+}
+
+void promote_actor(actor_system_t *system, actor_id_t actor, actor_priority_t priority) {
+    message_queue_t *queue = &get_actor(system, actor)->message_queue;
+    uint64_t generation = (uint64_t)actor & ACTOR_GENERATION;
+    uint64_t ready = atomic_load(&queue->ready);
+
+    // Actor may have handled the message and died meanwhile, its slot may be reused.
+    while ((ready & ACTOR_GENERATION) == generation) {
+        uint64_t place = ACTOR_READY_PLACE(ready);
+        if (place == ACTOR_READY_NONE)
+            return;
+
+        if (place < ACTOR_READY_RUNNING(0)) {
+            if (place <= ACTOR_READY_QUEUED(priority))
+                return;
+
+            // Identifier left in the lower lane is skipped when it is popped.
+            if (atomic_compare_exchange_weak(&queue->ready, &ready,
+                                             generation | ACTOR_READY_QUEUED(priority))) {
+                schedule_actor(system, actor, priority);
+                return;
+            }
+        }
+        else {
+            if (place <= ACTOR_READY_RUNNING(priority))
+                return;
+
+            if (atomic_compare_exchange_weak(&queue->ready, &ready,
+                                             generation | ACTOR_READY_RUNNING(priority)))
+                return;
+        }
+    }
+}
+
+bool claim_actor(actor_system_t *system, actor_id_t actor, size_t lane) {
+    uint64_t generation = (uint64_t)actor & ACTOR_GENERATION;
+    uint64_t ready = generation | ACTOR_READY_QUEUED(lane);
+
+    return atomic_compare_exchange_strong(&get_actor(system, actor)->message_queue.ready, &ready,
+                                          generation | ACTOR_READY_RUNNING(ACTOR_PRIORITIES));
+}
+
+bool pop_local_actor(worker_t *worker, actor_id_t *actor, size_t *lane) {
+    lock_mutex(worker->system, &worker->actor_queue_mutex);
+
+    size_t first = first_lane(worker->turn++);
+    bool found = false;
+    for (size_t i = 0; i < ACTOR_PRIORITIES && !found; ++i) {
+        *lane = (first + i) % ACTOR_PRIORITIES;
+
+        found = !empty(&worker->actor_queues[*lane]);
+        if (found)
+            *actor = (actor_id_t)pop(&worker->actor_queues[*lane]);
+    }
+
+    if (pthread_mutex_unlock(&worker->actor_queue_mutex) != 0)
+        exit(1);
+
+    return found;
+}
+
+bool steal_actors(worker_t *worker, actor_id_t *actor, size_t *lane) {
+    actor_system_t *system = worker->system;
+    void *stolen[ACTOR_STEAL_LIMIT];
+    size_t worker_count = atomic_load(&system->worker_count);
+
+    for (size_t i = 1; i < worker_count; ++i) {
+        worker_t *victim = &system->workers[(worker->index + i) % worker_count];
+
+        lock_mutex(system, &victim->actor_queue_mutex);
+
+        size_t stolen_lane = 0;
+        while (stolen_lane + 1 < ACTOR_PRIORITIES && empty(&victim->actor_queues[stolen_lane]))
+            ++stolen_lane;
+
+        // Oldest actors are taken first, so stealing does not break fairness.
+        size_t count = (get_size(&victim->actor_queues[stolen_lane]) + 1) / 2;
+        if (count > ACTOR_STEAL_LIMIT)
+            count = ACTOR_STEAL_LIMIT;
+        for (size_t j = 0; j < count; ++j)
+            stolen[j] = pop(&victim->actor_queues[stolen_lane]);
+
+        if (pthread_mutex_unlock(&victim->actor_queue_mutex) != 0)
+            exit(1);
+
+        if (count == 0)
+            continue;
+
+        *actor = (actor_id_t)stolen[0];
+        *lane = stolen_lane;
+
+        TRACE(trace(worker, TRACE_STEAL, *actor, (long)count);)
+
+        METRICS(
+            atomic_fetch_add_explicit(&worker->metrics.steals, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&worker->metrics.stolen, count, memory_order_relaxed);
+        )
+
+        if (count > 1) {
+            lock_mutex(system, &worker->actor_queue_mutex);
+
+            for (size_t j = 1; j < count; ++j) {
+                if (push(&worker->actor_queues[stolen_lane], stolen[j]) != 0)
+                    exit(1);
+            }
+
+            if (pthread_mutex_unlock(&worker->actor_queue_mutex) != 0)
+                exit(1);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool work_available(actor_system_t *system) {
+    bool available = false;
+    size_t worker_count = atomic_load(&system->worker_count);
+
+    for (size_t i = 0; i < worker_count && !available; ++i) {
+        if (pthread_mutex_lock(&system->workers[i].actor_queue_mutex) != 0)
+            exit(1);
+
+        for (size_t j = 0; j < ACTOR_PRIORITIES && !available; ++j)
+            available = !empty(&system->workers[i].actor_queues[j]);
+
+        if (pthread_mutex_unlock(&system->workers[i].actor_queue_mutex) != 0)
+            exit(1);
+    }
+
+    return available;
+}
+
+void go_die(message_queue_t *queue) {
+    // From now on no more messages may be received. The slot is released when the worker
+    // finds the mailbox empty.
+    atomic_fetch_or(&queue->state, ACTOR_DEAD);
+}
+
+void spawn(actor_system_t *system, message_t message, actor_id_t actor) {
+    if (system->interrupted)
+        return;
+
+    lock_mutex(system, &system->system_state_mutex);
+
+    actor_id_t new_actor_id;
+
+    int err;
+    if ((err = create_actor(system, &new_actor_id, message.data)) == -1)
+        exit(1);
+    // If actor cannot be created due to the cast limit, nothing happens.
+    if (err == -2) {
+        if (pthread_mutex_unlock(&system->system_state_mutex) != 0)
+            exit(1);
+
+        return;
+    }
+
+    if (pthread_mutex_unlock(&system->system_state_mutex) != 0)
+        exit(1);
+
+    TRACE(trace(thread_worker, TRACE_SPAWN, new_actor_id, actor);)
+
+    // New actor should receive hello message.
+    if (send_message_to(system, new_actor_id, (message_t){.message_type = MSG_HELLO,
+            .data = (void *)actor, .nbytes = sizeof(actor_id_t)}) != 0)
+        exit(1);
+}
+
+bool actor_exists(actor_system_t *system, actor_id_t actor) {
+    if (actor < 0)
+        return false;
+
+    return ACTOR_INDEX(actor) < atomic_load(&system->slot_count);
+}
+
+int reset_signal_operation() {
+    if (sigaction(SIGINT, &old_action, NULL) != 0)
+        return -1;
+
+    LATENCY(
+        if (sigaction(SIGUSR1, &old_dump_action, NULL) != 0)
+            return -1;
+    )
+
+    return 0;
+}
+
+void destroy_thread_pool(actor_system_t *system, size_t created_threads_count) {
+    pthread_mutex_lock(&system->idle_mutex);
+    system->all_work_done = true;
+    pthread_cond_broadcast(&system->cond);
+    pthread_cond_broadcast(&system->spare_cond);
+    pthread_mutex_unlock(&system->idle_mutex);
+
+    for (size_t i = 0; i < created_threads_count; ++i) {
+        if (pthread_join(system->workers[i].thread, NULL) != 0)
+            exit(1);
+    }
+
+    destroy_workers(system);
+}
+
+void destroy_workers(actor_system_t *system) {
+    for (size_t i = 0; i < system->pool_size + system->spare_limit; ++i) {
+        pthread_mutex_destroy(&system->workers[i].actor_queue_mutex);
+        delete_ready_queues(&system->workers[i]);
+        delete_slab_pool(&system->workers[i].envelope_pool);
+
+        LATENCY(
+            for (size_t j = 0; j < ACTOR_LATENCY_KEYS; ++j)
+                free(atomic_load(&system->workers[i].latency[j]));
+        )
+        TRACE(free(system->workers[i].trace);)
+    }
+}
+
+void destroy_actors(actor_system_t *system) {
+    // Messages left after an interruption are freed together with envelope pools.
+    // Deleting state and role is user's responsibility.
+    for (size_t i = 0; i < ACTOR_CHUNKS; ++i)
+        free(atomic_load(&system->actor_chunks[i]));
+}
+
+void destroy_actor_system(actor_system_t *system) {
+    destroy_timers(system);
+
+    if (pthread_cond_destroy(&system->spare_cond) != 0)
+        exit(1);
+    if (pthread_cond_destroy(&system->cond) != 0)
+        exit(1);
+    if (pthread_mutex_destroy(&system->system_state_mutex) != 0)
+        exit(1);
+    if (pthread_mutex_destroy(&system->idle_mutex) != 0)
+        exit(1);
+    if (pthread_mutex_destroy(&system->external_pool_mutex) != 0)
+        exit(1);
+
+    destroy_actors(system);
+    delete_queue(&system->free_slots);
+    destroy_workers(system);
+    free(system->workers);
+    delete_slab_pool(&system->external_pool);
+    unregister_system(system);
+    TRACE(free(system->trace_file);)
+
+    if (default_system == system)
+        default_system = NULL;
+    free(system);
+}
+
+actor_id_t actor_id_self() {
+    return thread_actor;
+}
+
+actor_system_t *actor_system_self() {
+    return thread_worker != NULL ? thread_worker->system : NULL;
+}
+
+void actor_cpu_mask_clear(actor_cpu_mask_t *mask) {
+    memset(mask->bits, 0, sizeof(mask->bits));
+}
+
+void actor_cpu_mask_set(actor_cpu_mask_t *mask, size_t cpu) {
+    if (cpu < ACTOR_MAX_CPUS)
+        mask->bits[cpu / 64] |= 1ULL << (cpu % 64);
+}
+
+void actor_system_config_init(actor_system_config_t *config) {
+    config->pool_size = 0;
+    config->affinity = NULL;
+    config->naffinity = 0;
+    config->numa_nodes = NULL;
+    config->nnuma_nodes = 0;
+    config->pin_workers = false;
+    config->queue_limit = 0;
+    config->cast_limit = 0;
+    config->throughput = 0;
+    config->idle_spins = ACTOR_IDLE_SPINS;
+    config->idle_yields = ACTOR_IDLE_YIELDS;
+    config->spare_workers = 0;
+    config->trace_file = NULL;
+}
+
+int actor_system_create(actor_id_t *actor, role_t *const role) {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = POOL_SIZE;
+
+    return actor_system_create_config(actor, role, &config);
+}
+
+int actor_system_create_config(actor_id_t *actor, role_t *const role,
+                               const actor_system_config_t *config) {
+    if (default_system != NULL)
+        return -1;
+
+    return actor_system_start(&default_system, actor, role, config);
+}
+
+int actor_system_start(actor_system_t **system_ptr, actor_id_t *actor, role_t *const role,
+                       const actor_system_config_t *config) {
+    *system_ptr = NULL;
+
+    if (config->cast_limit > CAST_LIMIT || config->queue_limit >= ACTOR_MESSAGES)
+        return -1;
+
+    size_t pool_size = config->pool_size;
+    if (pool_size == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        pool_size = online > 0 ? (size_t)online : 1;
+    }
+
+    actor_system_t *system = malloc(sizeof(actor_system_t));
+    if (system == NULL)
+        return -1;
+
+    system->queue_limit = config->queue_limit > 0 ? config->queue_limit : ACTOR_QUEUE_LIMIT;
+    system->cast_limit = config->cast_limit > 0 ? config->cast_limit : CAST_LIMIT;
+    system->throughput = config->throughput > 0 ? config->throughput : ACTOR_THROUGHPUT;
+    system->idle_spins = config->idle_spins;
+    system->idle_yields = config->idle_yields;
+
+    system->pool_size = pool_size;
+    system->spare_limit = config->spare_workers > 0 ? config->spare_workers : pool_size;
+    system->workers = aligned_alloc(CACHE_LINE_SIZE,
+                                    (pool_size + system->spare_limit) * sizeof(worker_t));
+    if (system->workers == NULL)
+        goto WORKERS_ERROR;
+
+    system->actor_count = 0;
+    atomic_init(&system->slot_count, 0);
+    for (size_t i = 0; i < ACTOR_CHUNKS; ++i)
+        atomic_init(&system->actor_chunks[i], NULL);
+    system->all_work_done = false;
+    system->interrupted = false;
+    atomic_init(&system->all_threads_returned, false);
+    system->returned_threads = 0;
+    atomic_init(&system->next_worker, 0);
+    atomic_init(&system->sleepers, 0);
+    atomic_init(&system->worker_count, pool_size);
+    atomic_init(&system->blocked, 0);
+
+    LATENCY(atomic_init(&system->latency_dump, false);)
+
+#ifdef CACTI_TRACE
+    const char *trace_file = config->trace_file != NULL ? config->trace_file :
+            getenv("CACTI_TRACE_FILE");
+    system->trace_file = NULL;
+    if (trace_file != NULL && (system->trace_file = strdup(trace_file)) == NULL)
+        goto FREE_SLOTS_ERROR;
+    system->trace_start_ns = monotonic_ns();
+#endif
+
+    METRICS(
+        memset(&system->external_metrics, 0, sizeof(worker_metrics_t));
+        system->spawns = 0;
+        system->deaths = 0;
+    )
+
+    if (create_queue(&system->free_slots) != 0)
+        goto FREE_SLOTS_ERROR;
+
+    create_slab_pool(&system->external_pool, sizeof(envelope_t));
+
+    if (pthread_mutex_init(&system->external_pool_mutex, 0) != 0)
+        goto POOL_MUTEX_ERROR;
+
+    if (pthread_mutex_init(&system->idle_mutex, 0) != 0)
+        goto MUTEX_ERROR;
+
+    if (pthread_mutex_init(&system->system_state_mutex, 0) != 0)
+        goto STATE_MUTEX_ERROR;
+
+    if (pthread_cond_init(&system->cond, 0) != 0)
+        goto COND_ERROR;
+
+    if (pthread_cond_init(&system->spare_cond, 0) != 0)
+        goto SPARE_COND_ERROR;
+
+    if (create_timers(system) != 0)
+        goto TIMERS_ERROR;
+
+    if (create_thread_pool(system, config) != 0)
+        goto THREADS_ERROR;
+
+    if (register_system(system) != 0)
+        goto REGISTER_ERROR;
+
+    if (create_actor(system, actor, role) != 0)
+        goto NEW_ACTOR_ERROR;
+
+    *system_ptr = system;
+    send_message_to(system, *actor, (message_t){.message_type = MSG_HELLO,
+            .nbytes = 0, .data = NULL});
+
+    return 0;
+
+    NEW_ACTOR_ERROR:
+        unregister_system(system);
+    REGISTER_ERROR:
+        destroy_thread_pool(system, system->pool_size);
+    THREADS_ERROR:
+        destroy_timers(system);
+    TIMERS_ERROR:
+        if (pthread_cond_destroy(&system->spare_cond) != 0)
+            exit(1);
+    SPARE_COND_ERROR:
+        if (pthread_cond_destroy(&system->cond) != 0)
+            exit(1);
+    COND_ERROR:
+        if (pthread_mutex_destroy(&system->system_state_mutex) != 0)
+            exit(1);
+    STATE_MUTEX_ERROR:
+        if (pthread_mutex_destroy(&system->idle_mutex) != 0)
+            exit(1);
+    MUTEX_ERROR:
+        if (pthread_mutex_destroy(&system->external_pool_mutex) != 0)
+            exit(1);
+    POOL_MUTEX_ERROR:
+        delete_queue(&system->free_slots);
+    FREE_SLOTS_ERROR:
+        TRACE(free(system->trace_file);)
+        free(system->workers);
+    WORKERS_ERROR:
+        free(system);
+        return -1;
+}
+
+void actor_system_join(actor_id_t actor) {
+    actor_system_t *system = default_system;
+    if (system == NULL || !actor_exists(system, actor))
+        return;
+
+    actor_system_wait(system);
+}
+
+void actor_system_wait(actor_system_t *system) {
+    // Spare workers are started only by running ones, so they are counted before those
+    // which started them return.
+    for (size_t i = 0; i < atomic_load(&system->worker_count); ++i) {
+        if (pthread_join(system->workers[i].thread, NULL) != 0)
+            exit(1);
+    }
+
+    if (!system->interrupted) {
+        TRACE(
+            if (system->trace_file != NULL)
+                actor_system_trace_write(system, system->trace_file);
+        )
+        destroy_actor_system(system);
+        return;
+    }
+
+    // Interrupted process is killed when threads of other systems return too.
+    while (!all_systems_returned())
+        sched_yield();
+
+    reset_signal_operation();
+    raise(SIGINT);
+}
+
+int actor_system_stats(actor_system_t *system, actor_system_stats_t *stats) {
+    memset(stats, 0, sizeof(actor_system_stats_t));
+
+    if (system == NULL)
+        system = current_system();
+
+#ifndef CACTI_METRICS
+    return -1;
+#else
+    if (system == NULL)
+        return -1;
+
+    stats->queue_limit = system->queue_limit;
+
+    lock_mutex(system, &system->system_state_mutex);
+    stats->spawns = system->spawns;
+    stats->deaths = system->deaths;
+    size_t live_actors = system->actor_count;
+    if (pthread_mutex_unlock(&system->system_state_mutex) != 0)
+        exit(1);
+
+    stats->nworkers = atomic_load(&system->worker_count);
+    stats->workers = malloc(stats->nworkers * sizeof(actor_worker_stats_t));
+    // Actors may appear while they are counted.
+    size_t capacity = live_actors + ACTOR_CHUNK_SIZE;
+    stats->actors = malloc(capacity * sizeof(actor_stats_t));
+    if (stats->workers == NULL || stats->actors == NULL) {
+        actor_system_stats_free(stats);
+        return -1;
+    }
+
+    for (size_t i = 0; i < stats->nworkers; ++i) {
+        copy_worker_metrics(&system->workers[i].metrics, &stats->workers[i]);
+        add_worker_stats(&stats->total, &stats->workers[i]);
+    }
+    copy_worker_metrics(&system->external_metrics, &stats->external);
+    add_worker_stats(&stats->total, &stats->external);
+
+    size_t slot_count = atomic_load(&system->slot_count);
+    for (size_t i = 0; i < slot_count && stats->nactors < capacity; ++i) {
+        actor_properties_t *properties = get_actor(system, (actor_id_t)i);
+        uint64_t state = atomic_load(&properties->message_queue.state);
+
+        // Slot of a released actor.
+        if ((state & ACTOR_DEAD) != 0 && (state & ACTOR_MESSAGES) == 0)
+            continue;
+
+        actor_stats_t *actor = &stats->actors[stats->nactors++];
+        actor->actor = (actor_id_t)((state & ACTOR_GENERATION) | i);
+        actor->queued = state & ACTOR_MESSAGES;
+        actor->messages_processed = atomic_load_explicit(&properties->metrics.processed,
+                                                         memory_order_relaxed);
+        actor->messages_received = actor->messages_processed + actor->queued;
+        actor->messages_rejected = atomic_load_explicit(&properties->metrics.rejected,
+                                                        memory_order_relaxed);
+        actor->queue_high_water = atomic_load_explicit(&properties->metrics.high_water,
+                                                       memory_order_relaxed);
+    }
+
+    return 0;
+#endif
+}
+
+void actor_system_stats_free(actor_system_stats_t *stats) {
+    free(stats->workers);
+    free(stats->actors);
+    stats->workers = NULL;
+    stats->actors = NULL;
+    stats->nworkers = 0;
+    stats->nactors = 0;
+}
+
+void actor_system_stats_print(const actor_system_stats_t *stats, int fd) {
+    const actor_worker_stats_t *t = &stats->total;
+
+    dprintf(fd, "spawns %llu deaths %llu queue_limit %zu\n", stats->spawns, stats->deaths,
+            stats->queue_limit);
+    dprintf(fd, "total processed %llu sent %llu rejected %llu runs %llu steals %llu/%llu "
+                "busy_ns %llu idle_ns %llu lock_wait_ns %llu\n",
+            t->messages_processed, t->messages_sent, t->messages_rejected, t->actor_runs,
+            t->steals, t->stolen_actors, t->busy_ns, t->idle_ns, t->lock_wait_ns);
+
+    for (size_t i = 0; i < stats->nworkers; ++i) {
+        const actor_worker_stats_t *w = &stats->workers[i];
+        dprintf(fd, "worker %zu processed %llu sent %llu rejected %llu runs %llu "
+                    "steals %llu/%llu busy_ns %llu idle_ns %llu lock_wait_ns %llu\n",
+                i, w->messages_processed, w->messages_sent, w->messages_rejected,
+                w->actor_runs, w->steals, w->stolen_actors, w->busy_ns, w->idle_ns,
+                w->lock_wait_ns);
+    }
+
+    dprintf(fd, "external sent %llu rejected %llu lock_wait_ns %llu\n",
+            stats->external.messages_sent, stats->external.messages_rejected,
+            stats->external.lock_wait_ns);
+
+    for (size_t i = 0; i < stats->nactors; ++i) {
+        const actor_stats_t *a = &stats->actors[i];
+        dprintf(fd, "actor %ld received %llu processed %llu rejected %llu queued %zu "
+                    "high_water %zu\n",
+                a->actor, a->messages_received, a->messages_processed, a->messages_rejected,
+                a->queued, a->queue_high_water);
+    }
+}
+
+int actor_system_latency_print(actor_system_t *system, int fd) {
+    if (system == NULL)
+        system = current_system();
+
+#ifndef CACTI_LATENCY
+    (void)fd;
+    return -1;
+#else
+    if (system == NULL)
+        return -1;
+
+    // Histograms of all workers merged by their keys.
+    size_t worker_count = atomic_load(&system->worker_count);
+    size_t capacity = worker_count * ACTOR_LATENCY_KEYS;
+    latency_entry_t **merged = malloc(capacity * sizeof(latency_entry_t *));
+    if (merged == NULL)
+        return -1;
+
+    size_t merged_count = 0;
+    int err = 0;
+    char prefix[32];
+
+    for (size_t i = 0; i < worker_count; ++i) {
+        snprintf(prefix, sizeof(prefix), "worker %zu", i);
+
+        for (size_t j = 0; j < ACTOR_LATENCY_KEYS; ++j) {
+            latency_entry_t *entry = atomic_load_explicit(&system->workers[i].latency[j],
+                                                          memory_order_acquire);
+            if (entry == NULL)
+                continue;
+
+            print_latency_entry(fd, prefix, entry);
+
+            size_t k = 0;
+            while (k < merged_count && (merged[k]->prompts != entry->prompts ||
+                                        merged[k]->message_type != entry->message_type))
+                ++k;
+
+            if (k == merged_count) {
+                merged[k] = create_latency_entry(entry->prompts, entry->message_type);
+                if (merged[k] == NULL) {
+                    err = -1;
+                    continue;
+                }
+                ++merged_count;
+            }
+
+            histogram_merge(&merged[k]->queue_ns, &entry->queue_ns);
+            histogram_merge(&merged[k]->handler_ns, &entry->handler_ns);
+        }
+    }
+
+    for (size_t k = 0; k < merged_count; ++k) {
+        print_latency_entry(fd, "all", merged[k]);
+        free(merged[k]);
+    }
+
+    free(merged);
+    return err;
+#endif
+}
+
+int actor_system_trace_write(actor_system_t *system, const char *path) {
+    if (system == NULL)
+        system = current_system();
+
+#ifndef CACTI_TRACE
+    (void)path;
+    return -1;
+#else
+    if (system == NULL)
+        return -1;
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+        return -1;
+
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (size_t i = 0; i < atomic_load(&system->worker_count); ++i)
+        write_trace_events(system, i, file, &first);
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0 ? 0 : -1;
+#endif
+}
+
+int send_message(actor_id_t actor, message_t message) {
+    return send_message_to(current_system(), actor, message);
+}
+
+int send_message_to(actor_system_t *system, actor_id_t actor, message_t message) {
+    return send_message_batch_to(system, actor, &message, 1);
+}
+
+int send_message_priority(actor_id_t actor, message_t message, actor_priority_t priority) {
+    return send_message_priority_to(current_system(), actor, message, priority);
+}
+
+int send_message_priority_to(actor_system_t *system, actor_id_t actor, message_t message,
+                             actor_priority_t priority) {
+    if ((unsigned)priority >= ACTOR_PRIORITIES)
+        return -4;
+    if (system == NULL || !actor_exists(system, actor))
+        return -2;
+
+    envelope_t *envelope = create_envelopes(system, 1);
+    envelope->message = message;
+
+    return send_envelopes(system, actor, envelope, envelope, 1, priority);
+}
+
+int send_message_batch(actor_id_t actor, const message_t *messages, size_t count) {
+    return send_message_batch_to(current_system(), actor, messages, count);
+}
+
+int send_message_batch_to(actor_system_t *system, actor_id_t actor, const message_t *messages,
+                          size_t count) {
+    if (system == NULL || !actor_exists(system, actor))
+        return -2;
+
+    if (count == 0)
+        return 0;
+    if (count > system->queue_limit)
+        return -3;
+
+    // Create messages.
+    envelope_t *first = create_envelopes(system, count);
+    envelope_t *last = first;
+    for (size_t i = 0; ; ++i) {
+        last->message = messages[i];
+        if (i + 1 == count)
+            break;
+
+        last = (envelope_t *)atomic_load_explicit(&last->node.next, memory_order_relaxed);
+    }
+
+    return send_envelopes(system, actor, first, last, count, ACTOR_PRIORITY_NORMAL);
+}
+
+int send_message_inline(actor_id_t actor, message_type_t message_type, const void *payload,
+                        size_t nbytes) {
+    return send_message_inline_to(current_system(), actor, message_type, payload, nbytes);
+}
+
+int send_message_inline_to(actor_system_t *system, actor_id_t actor, message_type_t message_type,
+                           const void *payload, size_t nbytes) {
+    if (system == NULL || !actor_exists(system, actor))
+        return -2;
+
+    envelope_t *envelope = create_envelopes(system, 1);
+    envelope->message.message_type = message_type;
+    envelope->message.nbytes = nbytes;
+
+    if (nbytes <= ACTOR_INLINE_PAYLOAD) {
+        envelope->message.data = envelope->payload;
+    }
+    else {
+        envelope->message.data = malloc(nbytes);
+        if (envelope->message.data == NULL)
+            exit(1);
+        envelope->owns_data = true;
+    }
+
+    if (nbytes > 0)
+        memcpy(envelope->message.data, payload, nbytes);
+
+    return send_envelopes(system, actor, envelope, envelope, 1, ACTOR_PRIORITY_NORMAL);
+}
+
+int send_envelopes(actor_system_t *system, actor_id_t actor, envelope_t *first, envelope_t *last,
+                   size_t count, actor_priority_t priority) {
+    int reserved = reserve_messages(system, actor, count);
+    if (reserved < 0) {
+        release_envelopes(first);
+        return reserved;
+    }
+
+    // Messages of one call are not interleaved with other senders' ones.
+    mailbox_push_chain(&get_actor(system, actor)->message_queue.mailboxes[priority], &first->node,
+                       &last->node);
+
+    // If actor was idle, its information needs to be pushed into a ready queue. Otherwise
+    // it may wait in a lane lower than the messages.
+    if (reserved == 1)
+        schedule_actor(system, actor, mark_actor_queued(system, actor, priority));
+    else if (priority != ACTOR_PRIORITY_LOW)
+        promote_actor(system, actor, priority);
+
+    return 0;
+}
+
+int send_message_multicast(const actor_id_t *actors, size_t count, message_t message,
+                           int *results) {
+    return send_message_multicast_to(current_system(), actors, count, message, results);
+}
+
+int send_message_multicast_to(actor_system_t *system, const actor_id_t *actors, size_t count,
+                              message_t message, int *results) {
+    int err = 0;
+    actor_id_t woken[ACTOR_MULTICAST_GROUP];
+
+    for (size_t group = 0; group < count; group += ACTOR_MULTICAST_GROUP) {
+        size_t group_end = group + ACTOR_MULTICAST_GROUP < count ?
+                group + ACTOR_MULTICAST_GROUP : count;
+        size_t woken_count = 0;
+
+        envelope_t *envelope = system != NULL ? create_envelopes(system, group_end - group) : NULL;
+        for (size_t i = group; i < group_end; ++i) {
+            int result = -2;
+
+            if (system != NULL && actor_exists(system, actors[i])) {
+                envelope_t *current = envelope;
+                envelope = (envelope_t *)atomic_load_explicit(&current->node.next,
+                                                              memory_order_relaxed);
+                current->message = message;
+
+                result = reserve_messages(system, actors[i], 1);
+                if (result < 0) {
+                    release_envelope(current);
+                }
+                else {
+                    mailbox_push(&get_actor(system, actors[i])->message_queue
+                                         .mailboxes[ACTOR_PRIORITY_NORMAL], &current->node);
+                    if (result == 0) {
+                        promote_actor(system, actors[i], ACTOR_PRIORITY_NORMAL);
+                    }
+                    else {
+                        actor_priority_t lane = mark_actor_queued(system, actors[i],
+                                                                  ACTOR_PRIORITY_NORMAL);
+                        if (lane == ACTOR_PRIORITY_NORMAL)
+                            woken[woken_count++] = actors[i];
+                        else
+                            schedule_actor(system, actors[i], lane);
+                    }
+                    result = 0;
+                }
+            }
+
+            if (results != NULL)
+                results[i] = result;
+            if (err == 0)
+                err = result;
+        }
+
+        // Envelopes of actors which do not exist.
+        release_envelopes(envelope);
+
+        if (woken_count > 0)
+            schedule_actors(system, woken, woken_count, ACTOR_PRIORITY_NORMAL);
+    }
+
+    return err;
+}
+
+int send_message_after(actor_id_t actor, message_t message, unsigned long delay_ms,
+                       actor_timer_t *timer) {
+    return send_message_after_to(current_system(), actor, message, delay_ms, timer);
+}
+
+int send_message_after_to(actor_system_t *system, actor_id_t actor, message_t message,
+                          unsigned long delay_ms, actor_timer_t *timer) {
+    return add_timer(system, actor, message, delay_ms, 0, timer);
+}
+
+int send_message_every(actor_id_t actor, message_t message, unsigned long period_ms,
+                       actor_timer_t *timer) {
+    return send_message_every_to(current_system(), actor, message, period_ms, timer);
+}
+
+int send_message_every_to(actor_system_t *system, actor_id_t actor, message_t message,
+                          unsigned long period_ms, actor_timer_t *timer) {
+    if (period_ms == 0)
+        return -1;
+
+    return add_timer(system, actor, message, period_ms, period_ms, timer);
+}
+
+int actor_timer_cancel(actor_timer_t timer) {
+    return actor_timer_cancel_to(current_system(), timer);
+}
+
+int actor_timer_cancel_to(actor_system_t *system, actor_timer_t timer) {
+    if (system == NULL || timer < 0)
+        return -1;
+
+    size_t index = ACTOR_INDEX(timer);
+    uint64_t generation = (uint64_t)timer >> 32;
+    int err = -1;
+
+    lock_mutex(system, &system->timer_mutex);
+
+    if (index < system->timer_slot_count) {
+        timer_entry_t *entry = get_timer(system, index);
+
+        if (entry->active && entry->generation == generation) {
+            timer_wheel_remove(&system->timer_wheel, &entry->node);
+            release_timer(system, entry);
+            err = 0;
+        }
+    }
+
+    if (pthread_mutex_unlock(&system->timer_mutex) != 0)
+        exit(1);
+
+    return err;
+}
+
+void actor_blocking_begin() {
+    worker_t *w = thread_worker;
+    if (w == NULL || thread_blocking++ > 0)
+        return;
+
+    actor_system_t *system = w->system;
+
+    if (pthread_mutex_lock(&system->idle_mutex) != 0)
+        exit(1);
+
+    size_t spare = atomic_fetch_add(&system->blocked, 1);
+    if (spare < system->spare_limit) {
+        size_t index = system->pool_size + spare;
+
+        // Spare without a thread is the next one to be started. If it cannot be, the section
+        // is not compensated.
+        if (index < atomic_load(&system->worker_count)) {
+            if (pthread_cond_broadcast(&system->spare_cond) != 0)
+                exit(1);
+        }
+        else if (start_worker(&system->workers[index]) == 0) {
+            atomic_store(&system->worker_count, index + 1);
+        }
+    }
+
+    if (pthread_mutex_unlock(&system->idle_mutex) != 0)
+        exit(1);
+}
+
+void actor_blocking_end() {
+    worker_t *w = thread_worker;
+    if (w == NULL || thread_blocking == 0 || --thread_blocking > 0)
+        return;
+
+    actor_system_t *system = w->system;
+
+    // Spare which is not needed any more parks when it finishes its current actor.
+    if (pthread_mutex_lock(&system->idle_mutex) != 0)
+        exit(1);
+    atomic_fetch_sub(&system->blocked, 1);
+    if (pthread_mutex_unlock(&system->idle_mutex) != 0)
+        exit(1);
+}
+
+int actor_ask(actor_id_t actor, message_t message, actor_future_t **future) {
+    return actor_ask_to(current_system(), actor, message, future);
+}
+
+int actor_ask_to(actor_system_t *system, actor_id_t actor, message_t message,
+                 actor_future_t **future) {
+    *future = NULL;
+    if (system == NULL || !actor_exists(system, actor))
+        return -2;
+
+    actor_future_t *created = create_future();
+
+    // Request which is not sent is released, which drops the reference of its route.
+    int err = send_request(system, actor, message,
+                           (actor_reply_t){.system = system, .future = created, .actor = -1});
+    if (err != 0) {
+        release_future(created);
+        return err;
+    }
+
+    *future = created;
+    return 0;
+}
+
+int actor_ask_reply(actor_id_t actor, message_t message, message_type_t reply_type) {
+    worker_t *w = thread_worker;
+    if (w == NULL)
+        return -5;
+    if (!actor_exists(w->system, actor))
+        return -2;
+
+    return send_request(w->system, actor, message,
+                        (actor_reply_t){.system = w->system, .future = NULL,
+                                        .actor = thread_actor, .message_type = reply_type});
+}
+
+int actor_reply(message_t message) {
+    actor_reply_t route;
+    if (actor_defer_reply(&route) != 0)
+        return -1;
+
+    return actor_send_reply(&route, message);
+}
+
+int actor_defer_reply(actor_reply_t *route) {
+    envelope_t *envelope = thread_envelope;
+    if (envelope == NULL || (envelope->reply.future == NULL && envelope->reply.actor < 0))
+        return -1;
+
+    *route = envelope->reply;
+    envelope->reply.future = NULL;
+    envelope->reply.actor = -1;
+
+    return 0;
+}
+
+int actor_send_reply(actor_reply_t *route, message_t message) {
+    if (route->future != NULL) {
+        complete_future(route->future, &message);
+        route->future = NULL;
+        return 0;
+    }
+
+    if (route->actor < 0)
+        return -1;
+
+    actor_id_t asker = route->actor;
+    route->actor = -1;
+    message.message_type = route->message_type;
+
+    return send_message_to(route->system, asker, message);
+}
+
+int actor_future_wait(actor_future_t *future, message_t *reply) {
+    if (atomic_load(&future->state) == FUTURE_PENDING) {
+        actor_blocking_begin();
+
+        if (pthread_mutex_lock(&future->mutex) != 0)
+            exit(1);
+        while (atomic_load(&future->state) == FUTURE_PENDING) {
+            if (pthread_cond_wait(&future->cond, &future->mutex) != 0)
+                exit(1);
+        }
+        if (pthread_mutex_unlock(&future->mutex) != 0)
+            exit(1);
+
+        actor_blocking_end();
+    }
+
+    return actor_future_try(future, reply);
+}
+
+int actor_future_try(actor_future_t *future, message_t *reply) {
+    int state = atomic_load(&future->state);
+
+    if (state == FUTURE_PENDING)
+        return 1;
+    if (state == FUTURE_BROKEN)
+        return -1;
+
+    if (reply != NULL)
+        *reply = future->reply;
+    return 0;
+}
+
+void actor_future_free(actor_future_t *future) {
+    if (future != NULL)
+        release_future(future);
+}
+
+int actor_spawn(role_t *const role, void *state, actor_id_t *actor) {
+    return actor_spawn_to(current_system(), role, state, actor);
+}
+
+int actor_spawn_to(actor_system_t *system, role_t *const role, void *state, actor_id_t *actor) {
+    if (system == NULL)
+        return -2;
+
+    lock_mutex(system, &system->system_state_mutex);
+
+    // System without living actors has finished, so no actor may appear in it.
+    int err = -2;
+    if (system->actor_count > 0 && !system->interrupted)
+        err = create_actor(system, actor, role);
+
+    // State is installed before the identifier is known to senders.
+    if (err == 0)
+        get_actor(system, *actor)->state = state;
+
+    if (pthread_mutex_unlock(&system->system_state_mutex) != 0)
+        exit(1);
+
+    TRACE(
+        if (err == 0 && thread_worker != NULL && thread_worker->system == system)
+            trace(thread_worker, TRACE_SPAWN, *actor, thread_actor);
+    )
+
+    return err;
 }
@@ -2,6 +2,7 @@
 #define CACTI_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
 typedef long message_type_t;
 
@@ -21,6 +22,52 @@ typedef long message_type_t;
 #define POOL_SIZE 3
 #endif
 
+// Maximal number of actor systems existing at the same time.
+#ifndef ACTOR_MAX_SYSTEMS
+#define ACTOR_MAX_SYSTEMS 64
+#endif
+
+// Maximal number of messages of one actor handled in a row before other ready actors
+// get their turn.
+#ifndef ACTOR_THROUGHPUT
+#define ACTOR_THROUGHPUT 64
+#endif
+
+// Idle worker polls ready queues ACTOR_IDLE_SPINS times with busy waiting and then
+// ACTOR_IDLE_YIELDS times with yielding the processor, before it goes to sleep. Sleeping
+// workers are woken only by new work, which costs a system call on both sides.
+#ifndef ACTOR_IDLE_SPINS
+#define ACTOR_IDLE_SPINS 128
+#endif
+
+#ifndef ACTOR_IDLE_YIELDS
+#define ACTOR_IDLE_YIELDS 16
+#endif
+
+// Number of the newest events kept by each worker when tracing is enabled.
+#ifndef ACTOR_TRACE_EVENTS
+#define ACTOR_TRACE_EVENTS 65536
+#endif
+
+// Payloads of send_message_inline up to this size are copied into the message itself. With
+// the default size, the message and its payload take one cache line.
+#ifndef ACTOR_INLINE_PAYLOAD
+#define ACTOR_INLINE_PAYLOAD 32
+#endif
+
+// Every ACTOR_PRIORITY_STARVATION-th message taken from a mailbox, and actor taken from
+// a ready queue, comes from a lower priority lane if there is one, so lower priorities
+// are never starved.
+#ifndef ACTOR_PRIORITY_STARVATION
+#define ACTOR_PRIORITY_STARVATION 16
+#endif
+
+// Time in microseconds after which an actor yields even if it has not used up
+// ACTOR_THROUGHPUT. 0 disables the check.
+#ifndef ACTOR_TIME_BUDGET
+#define ACTOR_TIME_BUDGET 0
+#endif
+
 typedef struct message
 {
     message_type_t message_type;
@@ -30,8 +77,24 @@ typedef struct message
 
 typedef long actor_id_t;
 
+// Messages of each priority are kept in a separate lane of the mailbox, and actors woken
+// by them are put in a separate lane of the ready queue. Higher lanes go first.
+typedef enum actor_priority
+{
+    ACTOR_PRIORITY_HIGH,
+    ACTOR_PRIORITY_NORMAL,
+    ACTOR_PRIORITY_LOW,
+} actor_priority_t;
+
+#define ACTOR_PRIORITIES 3
+
+typedef struct actor_system actor_system_t;
+
 actor_id_t actor_id_self();
 
+// Returns the system whose worker calls the function, NULL outside of thread pools.
+actor_system_t *actor_system_self();
+
 typedef void (*const act_t)(void **stateptr, size_t nbytes, void *data);
 
 typedef struct role
@@ -40,10 +103,272 @@ typedef struct role
     act_t *prompts;
 } role_t;
 
+#define ACTOR_MAX_CPUS 1024
+
+typedef struct actor_cpu_mask
+{
+    unsigned long long bits[ACTOR_MAX_CPUS / 64];
+} actor_cpu_mask_t;
+
+typedef struct actor_system_config
+{
+    // Number of worker threads. 0 means the number of online processors.
+    size_t pool_size;
+
+    // If not NULL, worker i runs only on processors from affinity[i % naffinity].
+    const actor_cpu_mask_t *affinity;
+    size_t naffinity;
+
+    // Used if [affinity] is NULL. If not NULL, worker i runs only on processors of NUMA
+    // node numa_nodes[i % nnuma_nodes].
+    const int *numa_nodes;
+    size_t nnuma_nodes;
+
+    // Used if neither [affinity] nor [numa_nodes] is given. If true, worker i runs only on
+    // i-th (modulo their number) processor the process may use.
+    bool pin_workers;
+
+    // Limits of the system. 0 means ACTOR_QUEUE_LIMIT, CAST_LIMIT and ACTOR_THROUGHPUT
+    // respectively. [cast_limit] cannot exceed CAST_LIMIT.
+    size_t queue_limit;
+    size_t cast_limit;
+    size_t throughput;
+
+    // Polling of idle workers, see ACTOR_IDLE_SPINS and ACTOR_IDLE_YIELDS. More polling
+    // lowers latency of messages to idle systems, but uses more processor time.
+    size_t idle_spins;
+    size_t idle_yields;
+
+    // Maximal number of spare workers, which run ready actors while handlers of other workers
+    // are in blocking sections. 0 means [pool_size]. Spare worker j is pinned as worker
+    // pool_size + j would be.
+    size_t spare_workers;
+
+    // File to which the trace is written when the system finishes, if the library is built
+    // with CACTI_TRACE. If NULL, value of CACTI_TRACE_FILE environment variable is used.
+    const char *trace_file;
+} actor_system_config_t;
+
+// Counters of one worker, or of all threads outside of the thread pool.
+typedef struct actor_worker_stats
+{
+    unsigned long long messages_processed;
+    unsigned long long messages_sent;       // Accepted by their receivers.
+    unsigned long long messages_rejected;   // Refused with -3.
+    unsigned long long actor_runs;          // Actors taken from ready queues.
+    unsigned long long steals;
+    unsigned long long stolen_actors;
+    // Times are added when a worker starts and finishes executing an actor.
+    unsigned long long busy_ns;             // Time of executing actors.
+    unsigned long long idle_ns;             // Time of looking for actors and sleeping.
+    unsigned long long lock_wait_ns;        // Time of waiting for contended locks.
+} actor_worker_stats_t;
+
+typedef struct actor_stats
+{
+    actor_id_t actor;
+    unsigned long long messages_received;
+    unsigned long long messages_processed;  // Including the one being handled.
+    unsigned long long messages_rejected;
+    size_t queued;
+    size_t queue_high_water;                // Compare with [queue_limit] of the system.
+} actor_stats_t;
+
+typedef struct actor_system_stats
+{
+    size_t queue_limit;
+    unsigned long long spawns;              // Actors created, including the first one.
+    unsigned long long deaths;              // Actors which died and handled all messages.
+
+    actor_worker_stats_t total;             // Sum of [workers] and [external].
+    actor_worker_stats_t external;
+    size_t nworkers;
+    actor_worker_stats_t *workers;
+
+    // Actors which are alive or still have messages.
+    size_t nactors;
+    actor_stats_t *actors;
+} actor_system_stats_t;
+
+void actor_cpu_mask_clear(actor_cpu_mask_t *mask);
+
+void actor_cpu_mask_set(actor_cpu_mask_t *mask, size_t cpu);
+
+// Fills [config] with defaults: one unpinned worker per online processor and compile-time
+// limits and polling.
+void actor_system_config_init(actor_system_config_t *config);
+
+// Works as actor_system_create with POOL_SIZE replaced by [config]. Returns -1 also if
+// [config] asks for pinning which cannot be done.
+int actor_system_create_config(actor_id_t *actor, role_t *const role,
+                               const actor_system_config_t *config);
+
 int actor_system_create(actor_id_t *actor, role_t *const role);
 
 void actor_system_join(actor_id_t actor);
 
+// Sends within the calling worker's system, or the default one outside of thread pools.
 int send_message(actor_id_t actor, message_t message);
 
+// Takes a snapshot of counters of [system] (if NULL, of the one send_message would use).
+// Counters are kept only if the library is built with CACTI_METRICS, otherwise it returns
+// -1. Snapshot has to be freed with actor_system_stats_free.
+int actor_system_stats(actor_system_t *system, actor_system_stats_t *stats);
+
+void actor_system_stats_free(actor_system_stats_t *stats);
+
+// Writes [stats] to file descriptor [fd] as text, one worker or actor per line.
+void actor_system_stats_print(const actor_system_stats_t *stats, int fd);
+
+// Writes percentiles of latency histograms of [system] (if NULL, of the one send_message
+// would use) to file descriptor [fd], one line per worker, role and message type, then one
+// line per role and message type for all workers together. Roles are identified by their
+// prompts.
+// Queueing time is measured from sending to taking the message from the mailbox, handler
+// time is the execution of the message. Histograms are kept only if the library is built
+// with CACTI_LATENCY, otherwise it returns -1. Such a library also writes them to stderr
+// on SIGUSR1.
+int actor_system_latency_print(actor_system_t *system, int fd);
+
+// Writes the newest events of [system] (if NULL, of the one send_message would use) to
+// [path] in Chrome trace format, which can be loaded by chrome://tracing or Perfetto. Each
+// worker is a separate thread of the timeline with handler executions, spawns, deaths,
+// steals and sleeping. Events are kept only if the library is built with CACTI_TRACE,
+// otherwise it returns -1.
+int actor_system_trace_write(actor_system_t *system, const char *path);
+
+// Creates a system independent of the default one and of each other, with its own thread
+// pool and limits. Identifiers of actors are valid only within their system.
+int actor_system_start(actor_system_t **system, actor_id_t *actor, role_t *const role,
+                       const actor_system_config_t *config);
+
+// Waits until all actors of [system] die and destroys it.
+void actor_system_wait(actor_system_t *system);
+
+int send_message_to(actor_system_t *system, actor_id_t actor, message_t message);
+
+// Sends [message] with [priority]. It is the only function which takes a priority, all other
+// ones (including batches, multicasts, inline payloads, requests, replies and timers) send
+// with ACTOR_PRIORITY_NORMAL. Messages are handled in order only within one priority. Actor
+// waiting in a lower lane of a ready queue is moved to the lane of [priority]. Returns -4
+// if [priority] is not valid.
+int send_message_priority(actor_id_t actor, message_t message, actor_priority_t priority);
+
+int send_message_priority_to(actor_system_t *system, actor_id_t actor, message_t message,
+                             actor_priority_t priority);
+
+// Sends a copy of [nbytes] bytes from [payload], so the sender does not have to keep it.
+// The handler gets a pointer to the copy, which is valid until it returns. Copies of up to
+// ACTOR_INLINE_PAYLOAD bytes need no allocation, bigger ones are taken from the heap.
+int send_message_inline(actor_id_t actor, message_type_t message_type, const void *payload,
+                        size_t nbytes);
+
+int send_message_inline_to(actor_system_t *system, actor_id_t actor, message_type_t message_type,
+                           const void *payload, size_t nbytes);
+
+// Sends [count] messages to [actor] at once, in order and not interleaved with messages of
+// other senders. Either all of them are sent, or none - it returns -3 if they do not fit
+// in the actor's queue together.
+int send_message_batch(actor_id_t actor, const message_t *messages, size_t count);
+
+int send_message_batch_to(actor_system_t *system, actor_id_t actor, const message_t *messages,
+                          size_t count);
+
+// Sends [message] to each of [count] [actors]. If [results] is not NULL, results[i] is set to
+// what send_message would return for actors[i]. Returns 0 if all sends succeeded, otherwise
+// the error of the first failed one.
+int send_message_multicast(const actor_id_t *actors, size_t count, message_t message,
+                           int *results);
+
+int send_message_multicast_to(actor_system_t *system, const actor_id_t *actors, size_t count,
+                              message_t message, int *results);
+
+// Identifies a timer within its system.
+typedef long actor_timer_t;
+
+// Sends [message] to [actor] after [delay_ms] milliseconds. Waiting is done by a timer thread
+// of the system, so it takes no worker time. Message which does not fit in the actor's queue
+// is sent a millisecond later. If [timer] is not NULL, it is set to the timer's identifier.
+// Returns -2 if the actor does not exist and -1 if the timer cannot be created.
+int send_message_after(actor_id_t actor, message_t message, unsigned long delay_ms,
+                       actor_timer_t *timer);
+
+int send_message_after_to(actor_system_t *system, actor_id_t actor, message_t message,
+                          unsigned long delay_ms, actor_timer_t *timer);
+
+// Works as send_message_after, but sends [message] every [period_ms] milliseconds, until
+// the timer is cancelled or the actor dies.
+int send_message_every(actor_id_t actor, message_t message, unsigned long period_ms,
+                       actor_timer_t *timer);
+
+int send_message_every_to(actor_system_t *system, actor_id_t actor, message_t message,
+                          unsigned long period_ms, actor_timer_t *timer);
+
+// Stops [timer] of the calling worker's system, or the default one outside of thread pools.
+// Returns -1 if the timer has already sent its last message or was cancelled.
+int actor_timer_cancel(actor_timer_t timer);
+
+int actor_timer_cancel_to(actor_system_t *system, actor_timer_t timer);
+
+// Marks the part of a handler until actor_blocking_end as blocking, e.g. sleeping, waiting
+// for I/O or for a lock. Meanwhile a spare worker, started on first use, runs other ready
+// actors, and it is parked again when the section ends. Nested sections count as one.
+// Outside of thread pools both functions do nothing.
+void actor_blocking_begin();
+
+void actor_blocking_end();
+
+typedef struct actor_future actor_future_t;
+
+// Route of the reply to a message sent with actor_ask or actor_ask_reply. Its fields are set
+// by the library.
+typedef struct actor_reply
+{
+    actor_system_t *system;
+    actor_future_t *future;         // Of actor_ask, NULL otherwise.
+    actor_id_t actor;               // Asker of actor_ask_reply, -1 otherwise.
+    message_type_t message_type;    // Of the reply sent to [actor].
+} actor_reply_t;
+
+// Sends [message] to [actor] as send_message does, and sets [future] to the future of its
+// reply, given by actor_reply. The future is set to NULL if the message is not sent, otherwise
+// it has to be freed with actor_future_free.
+int actor_ask(actor_id_t actor, message_t message, actor_future_t **future);
+
+int actor_ask_to(actor_system_t *system, actor_id_t actor, message_t message,
+                 actor_future_t **future);
+
+// Works as actor_ask, but the reply comes to the calling actor as a message of [reply_type].
+// If [actor] does not reply, nothing comes. Returns -5 if it is not called by a handler.
+int actor_ask_reply(actor_id_t actor, message_t message, message_type_t reply_type);
+
+// Replies to the message being handled by the calling handler. Returns -1 if the message was
+// not sent with actor_ask or actor_ask_reply, or it was replied to already, otherwise
+// the result of sending the reply.
+int actor_reply(message_t message);
+
+// Takes the route of the reply to the message being handled, so it can be replied to later
+// with actor_send_reply, exactly once. Returns -1 in cases in which actor_reply does.
+int actor_defer_reply(actor_reply_t *route);
+
+int actor_send_reply(actor_reply_t *route, message_t message);
+
+// Waits for the reply of [future] and stores it in [reply], if it is not NULL. Returns -1
+// if the message was released without a reply, e.g. its type was not handled. Waiting in
+// a handler is a blocking section, but the actor must not wait for its own reply.
+int actor_future_wait(actor_future_t *future, message_t *reply);
+
+// Works as actor_future_wait, but returns 1 at once if there is no reply yet.
+int actor_future_try(actor_future_t *future, message_t *reply);
+
+void actor_future_free(actor_future_t *future);
+
+// Creates an actor with [role] and [state] at once and sets [actor] to its identifier. Unlike
+// MSG_SPAWN, it sends no MSG_HELLO, so the actor gets only messages sent to it. It works in
+// the calling worker's system, or the default one outside of thread pools. Returns -2 if
+// the system has finished or reached its cast limit, -1 if memory cannot be allocated.
+int actor_spawn(role_t *const role, void *state, actor_id_t *actor);
+
+int actor_spawn_to(actor_system_t *system, role_t *const role, void *state, actor_id_t *actor);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <stddef.h>
+#include "histogram.h"
+
+static size_t bucket_index(unsigned long long value) {
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return (size_t)value;
+
+    // Position of the highest set bit decides the range, the following bits the bucket in it.
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - HISTOGRAM_SUB_BITS;
+    size_t sub = (size_t)(value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1);
+
+    return (size_t)(shift + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+// Returns the middle of the values falling into the bucket [index].
+static unsigned long long bucket_value(size_t index) {
+    if (index < HISTOGRAM_SUB_BUCKETS)
+        return index;
+
+    int shift = (int)(index / HISTOGRAM_SUB_BUCKETS) - 1;
+    unsigned long long sub = index % HISTOGRAM_SUB_BUCKETS;
+    unsigned long long lowest = (HISTOGRAM_SUB_BUCKETS + sub) << shift;
+
+    return lowest + ((1ULL << shift) >> 1);
+}
+
+void create_histogram(histogram_t *histogram) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+        atomic_init(&histogram->counts[i], 0);
+    atomic_init(&histogram->count, 0);
+    atomic_init(&histogram->max, 0);
+}
+
+void histogram_record(histogram_t *histogram, unsigned long long value) {
+    // Only one thread writes, so there is no need for read-modify-write operations.
+    atomic_ullong *bucket = &histogram->counts[bucket_index(value)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&histogram->count,
+                          atomic_load_explicit(&histogram->count, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+
+    if (value > atomic_load_explicit(&histogram->max, memory_order_relaxed))
+        atomic_store_explicit(&histogram->max, value, memory_order_relaxed);
+}
+
+void histogram_merge(histogram_t *into, const histogram_t *from) {
+    unsigned long long count = 0;
+
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        unsigned long long bucket = atomic_load_explicit(&from->counts[i], memory_order_relaxed);
+        count += bucket;
+        atomic_store_explicit(&into->counts[i],
+                              atomic_load_explicit(&into->counts[i], memory_order_relaxed) + bucket,
+                              memory_order_relaxed);
+    }
+
+    // Counted from buckets, so it matches them even if [from] changes meanwhile.
+    atomic_store_explicit(&into->count,
+                          atomic_load_explicit(&into->count, memory_order_relaxed) + count,
+                          memory_order_relaxed);
+
+    unsigned long long max = atomic_load_explicit(&from->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&into->max, memory_order_relaxed))
+        atomic_store_explicit(&into->max, max, memory_order_relaxed);
+}
+
+unsigned long long histogram_count(const histogram_t *histogram) {
+    return atomic_load_explicit(&histogram->count, memory_order_relaxed);
+}
+
+unsigned long long histogram_max(const histogram_t *histogram) {
+    return atomic_load_explicit(&histogram->max, memory_order_relaxed);
+}
+
+unsigned long long histogram_percentile(const histogram_t *histogram, double percentile) {
+    unsigned long long count = histogram_count(histogram);
+    if (count == 0)
+        return 0;
+
+    unsigned long long rank = (unsigned long long)(percentile / 100.0 * (double)count);
+    if (rank >= count)
+        rank = count - 1;
+
+    unsigned long long seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+        if (seen > rank) {
+            unsigned long long value = bucket_value(i);
+            unsigned long long max = histogram_max(histogram);
+            return value < max ? value : max;
+        }
+    }
+
+    return histogram_max(histogram);
+}
@@ -0,0 +1,36 @@
+#ifndef CACTI_HISTOGRAM_H
+#define CACTI_HISTOGRAM_H
+
+#include <stdatomic.h>
+
+// Each power of two range of values is split into 2^HISTOGRAM_SUB_BITS equal buckets,
+// so the relative error of a recorded value is at most 2^-HISTOGRAM_SUB_BITS.
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+// Log-linear histogram of unsigned values. Values are recorded by one thread, but may be
+// read by others at the same time.
+typedef struct histogram {
+    atomic_ullong counts[HISTOGRAM_BUCKETS];
+    atomic_ullong count;
+    atomic_ullong max;
+} histogram_t;
+
+void create_histogram(histogram_t *histogram);
+
+// Must be called by one thread at a time.
+void histogram_record(histogram_t *histogram, unsigned long long value);
+
+// Adds values of [from] to [into]. [into] must not be changed by other threads.
+void histogram_merge(histogram_t *into, const histogram_t *from);
+
+unsigned long long histogram_count(const histogram_t *histogram);
+
+unsigned long long histogram_max(const histogram_t *histogram);
+
+// Returns the value below which [percentile] percent of recorded values are, with the
+// precision of one bucket.
+unsigned long long histogram_percentile(const histogram_t *histogram, double percentile);
+
+#endif //CACTI_HISTOGRAM_H
@@ -1,11 +1,23 @@
 #include "cacti.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <ctype.h>
+#include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-#define MSG_MEET_CHILD 1
-#define MSG_COMPUTE 2
-#define MSG_GETDATA 3
+#define MSG_COMPUTE 1
+#define MSG_GETDATA 2
+#define MSG_SLEPT 2     // Sent only to actors of the parallel mode, which get no data.
+
+#define STREAM_WINDOW 256
+#define STREAM_BUFFER 65536
+
+// Without sleeps one actor sums up to [BLOCK_COLUMNS] columns of at least [BLOCK_ROWS] rows
+// per message.
+#define BLOCK_COLUMNS 1024
+#define BLOCK_ROWS 64
 
 typedef struct mat_cell {
     int sleep_time;
@@ -18,17 +30,50 @@ typedef struct row {
 } row_t;
 
 typedef struct mat mat_t;
+typedef struct stream stream_t;
 
 typedef void (*read_t)(mat_t *matrix, size_t row);
 
 struct mat {
     size_t k, n;
     size_t column;
-    matrix_cell_t *matrix;
+    size_t columns;         // Number of columns summed by one actor.
+    size_t rows;            // Number of rows summed per message.
+    long long *values;
+    int *sleep_times;
     row_t *row_sums;
     read_t read_val;
+    stream_t *stream;       // NULL if rows are not streamed.
+};
+
+typedef struct reader {
+    FILE *file;
+    size_t position, length;
+    char buffer[STREAM_BUFFER];
+} reader_t;
+
+typedef struct writer {
+    FILE *file;
+    size_t length;
+    char buffer[STREAM_BUFFER];
+} writer_t;
+
+// In streaming mode rows are read while earlier rows are summed, at most [STREAM_WINDOW]
+// rows at a time, and freed after being written.
+struct stream {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool ready;             // Whether all actors were spawned.
+    size_t in_flight;
+    writer_t writer;        // Used only by the actor of the last column.
 };
 
+typedef struct stream_row {
+    long long sum;
+    size_t row;
+    matrix_cell_t cells[];
+} stream_row_t;
+
 typedef struct state {
     actor_id_t father_id;
     actor_id_t my_id;
@@ -36,85 +81,265 @@ typedef struct state {
     mat_t matrix;
 } state_t;
 
+// In parallel mode every column is split into [stripes] actors, each summing every
+// [stripes]-th row. Sleeps are timers, so all cells of an actor wait at once without
+// blocking workers.
+typedef struct parallel_row {
+    _Atomic long long sum;
+    atomic_size_t done;     // Number of columns already added.
+} parallel_row_t;
+
+typedef struct parallel {
+    mat_t matrix;
+    size_t stripes;
+    parallel_row_t *rows;
+    pthread_mutex_t output_mutex;
+    size_t next_output;     // First row not printed yet, guarded by [output_mutex].
+} parallel_t;
+
+typedef struct parallel_state {
+    actor_id_t my_id;
+    parallel_t *parallel;
+    size_t column;
+    size_t row;
+    size_t pending;         // Cells whose timers have not fired yet.
+} parallel_state_t;
+
 void read_and_sum(mat_t *matrix, size_t row);
-void hello(void **stateptr, __attribute__((unused))size_t nbytes, void *data);
-void hello_first_actor(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+void sum_block(mat_t *matrix, size_t row);
+void hello(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
         __attribute__((unused))void *data);
 void get_data(void **stateptr, __attribute__((unused))size_t nbytes, void *data);
-void meet_your_child(void **stateptr, size_t nbytes, void *data);
 void compute(void **stateptr, __attribute__((unused))size_t nbytes, void *data);
+void get_parallel_data(void **stateptr, __attribute__((unused))size_t nbytes, void *data);
+void compute_parallel(void **stateptr, __attribute__((unused))size_t nbytes,
+        __attribute__((unused))void *data);
+void cell_slept(void **stateptr, __attribute__((unused))size_t nbytes, void *data);
+
+// Actors of columns are created with their states by actor_spawn, so only the first actor
+// gets MSG_HELLO.
+act_t prompts[2] = {hello, compute};
+act_t prompts_first_actor[3] = {hello, compute, get_data};
+act_t prompts_parallel[3] = {hello, compute_parallel, cell_slept};
+act_t prompts_parallel_first_actor[3] = {hello, compute_parallel, get_parallel_data};
+
+role_t role = {.prompts = prompts, .nprompts = 2};
+role_t parallel_role = {.prompts = prompts_parallel, .nprompts = 3};
+
+static int read_char(reader_t *reader) {
+    if (reader->position == reader->length) {
+        reader->length = fread(reader->buffer, 1, STREAM_BUFFER, reader->file);
+        reader->position = 0;
+
+        if (reader->length == 0)
+            return EOF;
+    }
+
+    return (unsigned char)reader->buffer[reader->position++];
+}
+
+// Reads a decimal integer, returns false if there is none.
+static bool read_number(reader_t *reader, long long *number) {
+    int c = read_char(reader);
+    while (c != EOF && isspace(c))
+        c = read_char(reader);
+
+    bool negative = c == '-';
+    if (negative)
+        c = read_char(reader);
+    if (c == EOF || !isdigit(c))
+        return false;
+
+    unsigned long long value = 0;
+    for (; c != EOF && isdigit(c); c = read_char(reader))
+        value = value * 10 + (unsigned long long)(c - '0');
 
-act_t prompts[3] = {hello, meet_your_child, compute};
-act_t prompts_first_actor[4] = {hello_first_actor, meet_your_child, compute, get_data};
+    *number = negative ? (long long)-value : (long long)value;
+    return true;
+}
+
+static long long read_number_or_exit(reader_t *reader) {
+    long long number;
+    if (!read_number(reader, &number))
+        exit(1);
+
+    return number;
+}
 
-role_t role = {.prompts = prompts, .nprompts = 3};
+static void flush_writer(writer_t *writer) {
+    if (fwrite(writer->buffer, 1, writer->length, writer->file) != writer->length)
+        exit(1);
+    writer->length = 0;
+}
+
+static void write_number(writer_t *writer, long long number) {
+    char digits[20];
+    size_t count = 0;
+    unsigned long long value = number < 0 ? -(unsigned long long)number : (unsigned long long)number;
+
+    // Sign, digits and a newline.
+    if (writer->length + sizeof(digits) + 2 > STREAM_BUFFER)
+        flush_writer(writer);
+
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    if (number < 0)
+        writer->buffer[writer->length++] = '-';
+    while (count > 0)
+        writer->buffer[writer->length++] = digits[--count];
+    writer->buffer[writer->length++] = '\n';
+}
+
+// Sleeps in a blocking section, so a spare worker runs other columns meanwhile.
+static void sleep_cell(int sleep_time) {
+    if (sleep_time == 0)
+        return;
+
+    actor_blocking_begin();
+    usleep(sleep_time * 1000);
+    actor_blocking_end();
+}
 
 void read_and_sum(mat_t *matrix, size_t row) {
     size_t index = row * matrix->n + matrix->column;
-    usleep(matrix->matrix[index].sleep_time * 1000);
-    matrix->row_sums[row].sum += matrix->matrix[index].value;
+    sleep_cell(matrix->sleep_times[index]);
+    matrix->row_sums[row].sum += matrix->values[index];
 }
 
-void hello(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
-    *stateptr = malloc(sizeof(state_t));
-    ((state_t *)(*stateptr))->father_id = (actor_id_t)data;
-    ((state_t *)(*stateptr))->my_id = actor_id_self();
+// Values of a row are contiguous, so the loop is vectorized by the compiler for whatever
+// the target supports.
+static long long sum_values(const long long *values, size_t count) {
+    long long sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum += values[i];
 
-    send_message(((state_t *)(*stateptr))->father_id,
-            (message_t){.message_type = MSG_MEET_CHILD,
-                             .nbytes = sizeof(state_t *), .data = *stateptr});
+    return sum;
 }
 
-void hello_first_actor(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+// Used instead of [read_and_sum] when there are no sleeps. A message covers [rows] rows of
+// the actor's [columns] columns, which are summed one row slice at a time, as the matrix is
+// stored by rows.
+void sum_block(mat_t *matrix, size_t row) {
+    size_t columns = matrix->n - matrix->column;
+    if (columns > matrix->columns)
+        columns = matrix->columns;
+
+    matrix->row_sums[row].sum += sum_values(&matrix->values[row * matrix->n + matrix->column],
+                                            columns);
+}
+
+void hello(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
         __attribute__((unused))void *data) {}
 
-void get_data(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
-    *stateptr = malloc(sizeof(state_t));
-    ((state_t *)(*stateptr))->my_id = actor_id_self();
-    ((state_t *)(*stateptr))->father_id = ((state_t *)(*stateptr))->my_id;
-    ((state_t *)(*stateptr))->matrix = *((mat_t *)data);
+// Starts summing rows after all actors of columns were spawned.
+static void start_rows(state_t *state) {
+    stream_t *stream = state->matrix.stream;
 
-    if (((state_t *)(*stateptr))->matrix.column + 1 < ((state_t *)(*stateptr))->matrix.n) {
-        send_message(((state_t *)(*stateptr))->my_id,
-                (message_t){.message_type = MSG_SPAWN,
-                            .nbytes = sizeof(role_t), .data = &role});
+    if (stream == NULL) {
+        send_message(state->father_id,
+                     (message_t){.message_type = MSG_COMPUTE, .nbytes = sizeof(row_t),
+                                 .data = &state->matrix.row_sums[0]});
+        return;
     }
-    else {
-        send_message(((state_t *)(*stateptr))->my_id,
-                (message_t){.message_type = MSG_COMPUTE, nbytes = sizeof(row_t),
-                .data = &((state_t *)(*stateptr))->matrix.row_sums[0]});
+
+    if (pthread_mutex_lock(&stream->mutex) != 0)
+        exit(1);
+    stream->ready = true;
+    if (pthread_cond_signal(&stream->cond) != 0)
+        exit(1);
+    if (pthread_mutex_unlock(&stream->mutex) != 0)
+        exit(1);
+}
+
+void get_data(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    state_t *state = malloc(sizeof(state_t));
+    if (state == NULL)
+        exit(1);
+    *stateptr = state;
+    state->my_id = actor_id_self();
+    state->father_id = state->my_id;
+    state->matrix = *((mat_t *)data);
+
+    // Actors of further columns are spawned from the last one, so each of them gets its
+    // child's identifier together with its state.
+    size_t columns = state->matrix.columns;
+    size_t blocks = (state->matrix.n - state->matrix.column + columns - 1) / columns;
+    actor_id_t child_id = -1;
+
+    for (size_t block = blocks - 1; block > 0; --block) {
+        state_t *child = malloc(sizeof(state_t));
+        if (child == NULL)
+            exit(1);
+        child->father_id = state->my_id;
+        child->child_id = child_id;
+        child->matrix = state->matrix;
+        child->matrix.column = state->matrix.column + block * columns;
+
+        if (actor_spawn(&role, child, &child_id) != 0)
+            exit(1);
+        child->my_id = child_id;
     }
+
+    state->child_id = child_id;
+    start_rows(state);
 }
 
-void meet_your_child(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
-    ((state_t *)(*stateptr))->child_id = ((state_t *)data)->my_id;
-    ((state_t *)data)->father_id = ((state_t *)(*stateptr))->father_id;
-    ((state_t *)data)->matrix.read_val = ((state_t *)(*stateptr))->matrix.read_val;
-    ((state_t *)data)->matrix.matrix = ((state_t *)(*stateptr))->matrix.matrix;
-    ((state_t *)data)->matrix.n = ((state_t *)(*stateptr))->matrix.n;
-    ((state_t *)data)->matrix.k = ((state_t *)(*stateptr))->matrix.k;
-    ((state_t *)data)->matrix.column = ((state_t *)(*stateptr))->matrix.column + 1;
-    ((state_t *)data)->matrix.row_sums = ((state_t *)(*stateptr))->matrix.row_sums;
+static void compute_stream(void **stateptr, stream_row_t *data) {
+    state_t *state = *stateptr;
+    stream_t *stream = state->matrix.stream;
+    matrix_cell_t *cell = &data->cells[state->matrix.column];
+    size_t row = data->row;
 
-    if (((state_t *)data)->matrix.column + 1 < ((state_t *)data)->matrix.n) {
-        send_message(((state_t *)(*stateptr))->child_id,
-                (message_t){.message_type = MSG_SPAWN, .nbytes = sizeof(role_t),
-                            .data = &role});
+    sleep_cell(cell->sleep_time);
+    data->sum += cell->value;
+
+    if (state->matrix.column + 1 == state->matrix.n) {
+        write_number(&stream->writer, data->sum);
+        free(data);
+
+        if (pthread_mutex_lock(&stream->mutex) != 0)
+            exit(1);
+        --stream->in_flight;
+        if (pthread_cond_signal(&stream->cond) != 0)
+            exit(1);
+        if (pthread_mutex_unlock(&stream->mutex) != 0)
+            exit(1);
     }
     else {
-        send_message(((state_t *)(*stateptr))->father_id,
-                     (message_t){.message_type = MSG_COMPUTE, .nbytes = sizeof(row_t),
-                                 .data = &((state_t *)(*stateptr))->matrix.row_sums[0]});
+        send_message(state->child_id, (message_t){.message_type = MSG_COMPUTE,
+                                                  .nbytes = sizeof(stream_row_t *),
+                                                  .data = data});
+    }
+
+    if (row + 1 == state->matrix.k) {
+        actor_id_t my_id = state->my_id;
+        free(state);
+        send_message(my_id, (message_t){.message_type = MSG_GODIE, .nbytes = 0, .data = NULL});
     }
 }
 
 void compute(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    if (((state_t *)(*stateptr))->matrix.stream != NULL) {
+        compute_stream(stateptr, data);
+        return;
+    }
+
     size_t row = ((row_t *)data)->row;
-    ((state_t *)(*stateptr))->matrix.read_val(&((state_t *)(*stateptr))->matrix, row);
+    size_t end = row + ((state_t *)(*stateptr))->matrix.rows;
+    if (end > ((state_t *)(*stateptr))->matrix.k)
+        end = ((state_t *)(*stateptr))->matrix.k;
+
+    for (size_t i = row; i < end; ++i)
+        ((state_t *)(*stateptr))->matrix.read_val(&((state_t *)(*stateptr))->matrix, i);
 
     // If current actor counts values in the last column.
-    if (((state_t *)(*stateptr))->matrix.column + 1 == ((state_t *)(*stateptr))->matrix.n) {
-        printf("%lld\n", ((state_t *)(*stateptr))->matrix.row_sums[row].sum);
+    if (((state_t *)(*stateptr))->matrix.column + ((state_t *)(*stateptr))->matrix.columns >=
+        ((state_t *)(*stateptr))->matrix.n) {
+        for (size_t i = row; i < end; ++i)
+            printf("%lld\n", ((state_t *)(*stateptr))->matrix.row_sums[i].sum);
     }
     else {
         send_message(((state_t *)(*stateptr))->child_id,
@@ -123,7 +348,7 @@ void compute(void **stateptr, __attribute__((unused))size_t nbytes, void *data)
     }
 
     // If current actor did all his work.
-    if (row + 1 == ((state_t *)(*stateptr))->matrix.k) {
+    if (end == ((state_t *)(*stateptr))->matrix.k) {
         size_t my_id = ((state_t *)(*stateptr))->my_id;
         free(*stateptr);
         send_message(my_id, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
@@ -133,20 +358,288 @@ void compute(void **stateptr, __attribute__((unused))size_t nbytes, void *data)
     else if (((state_t *)(*stateptr))->my_id == ((state_t *)(*stateptr))->father_id) {
         send_message(((state_t *)(*stateptr))->my_id,
                      (message_t){.message_type = MSG_COMPUTE, .nbytes = sizeof(row_t),
-                             .data = &((state_t *)(*stateptr))->matrix.row_sums[row + 1]});
+                             .data = &((state_t *)(*stateptr))->matrix.row_sums[end]});
+    }
+}
+
+// The first actor only spawns the actors of stripes and dies.
+void get_parallel_data(__attribute__((unused))void **stateptr,
+        __attribute__((unused))size_t nbytes, void *data) {
+    parallel_t *parallel = data;
+
+    for (size_t task = 0; task < parallel->matrix.n * parallel->stripes; ++task) {
+        parallel_state_t *child = malloc(sizeof(parallel_state_t));
+        if (child == NULL)
+            exit(1);
+        child->parallel = parallel;
+        child->column = task / parallel->stripes;
+        child->row = task % parallel->stripes;
+
+        actor_id_t child_id;
+        if (actor_spawn(&parallel_role, child, &child_id) != 0)
+            exit(1);
+        child->my_id = child_id;
+
+        send_message(child_id, (message_t){.message_type = MSG_COMPUTE, .nbytes = 0,
+                                           .data = NULL});
+    }
+
+    send_message(actor_id_self(), (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                              .data = NULL});
+}
+
+// Prints all finished rows which are next in order.
+static void print_parallel_rows(parallel_t *parallel) {
+    if (pthread_mutex_lock(&parallel->output_mutex) != 0)
+        exit(1);
+
+    while (parallel->next_output < parallel->matrix.k &&
+           atomic_load(&parallel->rows[parallel->next_output].done) == parallel->matrix.n) {
+        printf("%lld\n", atomic_load(&parallel->rows[parallel->next_output].sum));
+        ++parallel->next_output;
+    }
+
+    if (pthread_mutex_unlock(&parallel->output_mutex) != 0)
+        exit(1);
+}
+
+static void add_parallel_cell(parallel_state_t *state, size_t row_index) {
+    parallel_t *parallel = state->parallel;
+    parallel_row_t *row = &parallel->rows[row_index];
+
+    atomic_fetch_add(&row->sum, parallel->matrix.values[row_index * parallel->matrix.n +
+                                                        state->column]);
+
+    // The actor which adds the last column of a row prints it.
+    if (atomic_fetch_add(&row->done, 1) + 1 == parallel->matrix.n)
+        print_parallel_rows(parallel);
+}
+
+static void finish_parallel(parallel_state_t *state) {
+    actor_id_t my_id = state->my_id;
+    free(state);
+    send_message(my_id, (message_t){.message_type = MSG_GODIE, .nbytes = 0, .data = NULL});
+}
+
+void compute_parallel(void **stateptr, __attribute__((unused))size_t nbytes,
+        __attribute__((unused))void *data) {
+    parallel_state_t *state = *stateptr;
+    parallel_t *parallel = state->parallel;
+
+    state->pending = 0;
+    for (size_t row = state->row; row < parallel->matrix.k; row += parallel->stripes) {
+        int sleep_time = parallel->matrix.sleep_times[row * parallel->matrix.n + state->column];
+
+        if (sleep_time == 0) {
+            add_parallel_cell(state, row);
+            continue;
+        }
+
+        if (send_message_after(state->my_id, (message_t){.message_type = MSG_SLEPT, .nbytes = 0,
+                                                         .data = (void *)row},
+                               (unsigned long)sleep_time, NULL) != 0)
+            exit(1);
+        ++state->pending;
+    }
+
+    if (state->pending == 0)
+        finish_parallel(state);
+}
+
+void cell_slept(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    parallel_state_t *state = *stateptr;
+
+    add_parallel_cell(state, (size_t)data);
+
+    if (--state->pending == 0)
+        finish_parallel(state);
+}
+
+static void run_parallel(size_t k, size_t n, long long *values, int *sleep_times) {
+    actor_id_t actor;
+    parallel_t parallel;
+
+    parallel.matrix.values = values;
+    parallel.matrix.sleep_times = sleep_times;
+    parallel.matrix.k = k;
+    parallel.matrix.n = n;
+    parallel.matrix.column = 0;
+    parallel.matrix.columns = 1;
+    parallel.matrix.rows = 1;
+    parallel.matrix.row_sums = NULL;
+    parallel.matrix.read_val = NULL;
+    parallel.matrix.stream = NULL;
+    parallel.next_output = 0;
+    // Rows are split so that there are a few actors for every worker even with few columns.
+    parallel.stripes = (4 * POOL_SIZE + n - 1) / n;
+    if (parallel.stripes > k)
+        parallel.stripes = k;
+
+    parallel.rows = malloc(k * sizeof(parallel_row_t));
+    if (parallel.rows == NULL)
+        exit(1);
+    for (size_t i = 0; i < k; ++i) {
+        atomic_init(&parallel.rows[i].sum, 0);
+        atomic_init(&parallel.rows[i].done, 0);
+    }
+
+    if (pthread_mutex_init(&parallel.output_mutex, NULL) != 0)
+        exit(1);
+
+    role_t first_actor_role;
+    first_actor_role.prompts = prompts_parallel_first_actor;
+    first_actor_role.nprompts = 3;
+    if (actor_system_create(&actor, &first_actor_role) != 0)
+        exit(1);
+
+    send_message(actor, (message_t){.message_type = MSG_GETDATA, .nbytes = sizeof(parallel_t),
+                                    .data = &parallel});
+
+    actor_system_join(actor);
+
+    if (pthread_mutex_destroy(&parallel.output_mutex) != 0)
+        exit(1);
+    free(parallel.rows);
+}
+
+static void run_stream(reader_t *reader, size_t k, size_t n) {
+    actor_id_t actor;
+    static stream_t stream;
+
+    if (pthread_mutex_init(&stream.mutex, NULL) != 0)
+        exit(1);
+    if (pthread_cond_init(&stream.cond, NULL) != 0)
+        exit(1);
+    stream.ready = false;
+    stream.in_flight = 0;
+    stream.writer.file = stdout;
+    stream.writer.length = 0;
+
+    mat_t mat;
+    mat.values = NULL;
+    mat.sleep_times = NULL;
+    mat.row_sums = NULL;
+    mat.n = n;
+    mat.k = k;
+    mat.column = 0;
+    mat.columns = 1;
+    mat.rows = 1;
+    mat.read_val = NULL;
+    mat.stream = &stream;
+
+    role_t first_actor_role;
+    first_actor_role.prompts = prompts_first_actor;
+    first_actor_role.nprompts = 3;
+    if (actor_system_create(&actor, &first_actor_role) != 0)
+        exit(1);
+
+    send_message(actor, (message_t){.message_type = MSG_GETDATA, .nbytes = sizeof(mat_t),
+                                    .data = &mat});
+
+    for (size_t i = 0; i < k; ++i) {
+        stream_row_t *row = malloc(sizeof(stream_row_t) + n * sizeof(matrix_cell_t));
+        if (row == NULL)
+            exit(1);
+
+        row->sum = 0;
+        row->row = i;
+        for (size_t j = 0; j < n; ++j) {
+            row->cells[j].value = read_number_or_exit(reader);
+            row->cells[j].sleep_time = (int)read_number_or_exit(reader);
+        }
+
+        // Waits until actors are spawned and there is room for the row.
+        if (pthread_mutex_lock(&stream.mutex) != 0)
+            exit(1);
+        while (!stream.ready || stream.in_flight == STREAM_WINDOW) {
+            if (pthread_cond_wait(&stream.cond, &stream.mutex) != 0)
+                exit(1);
+        }
+        ++stream.in_flight;
+        if (pthread_mutex_unlock(&stream.mutex) != 0)
+            exit(1);
+
+        if (send_message(actor, (message_t){.message_type = MSG_COMPUTE,
+                                            .nbytes = sizeof(stream_row_t *), .data = row}) != 0)
+            exit(1);
     }
+
+    actor_system_join(actor);
+
+    flush_writer(&stream.writer);
+    if (pthread_cond_destroy(&stream.cond) != 0)
+        exit(1);
+    if (pthread_mutex_destroy(&stream.mutex) != 0)
+        exit(1);
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [-p | -s]\n"
+            "  -p  sum columns and rows in parallel, with sleeps as timers instead of blocking;\n"
+            "      a matrix without sleeps is summed by the default chain, which is faster\n"
+            "  -s  sum rows while the rest of the matrix is read\n", program);
 }
 
-int main(){
+int main(int argc, char **argv){
     size_t k, n;
     actor_id_t actor;
-    scanf("%zu", &k);
-    scanf("%zu", &n);
+    bool parallel = false;
+    bool stream = false;
+    static reader_t reader;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-p") == 0) {
+            parallel = true;
+        }
+        else if (strcmp(argv[i], "-s") == 0) {
+            stream = true;
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Streamed rows go through the chain, so the modes cannot be combined.
+    if (parallel && stream) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    reader.file = stdin;
+    k = (size_t)read_number_or_exit(&reader);
+    n = (size_t)read_number_or_exit(&reader);
 
-    matrix_cell_t *matrix = malloc(k * n * sizeof(matrix_cell_t));
+    if (k == 0 || n == 0) {
+        for (size_t i = 0; i < k; ++i)
+            printf("0\n");
+        return 0;
+    }
+
+    if (stream) {
+        run_stream(&reader, k, n);
+        return 0;
+    }
+
+    long long *values = malloc(k * n * sizeof(long long));
+    int *sleep_times = malloc(k * n * sizeof(int));
+    if (values == NULL || sleep_times == NULL)
+        exit(1);
+
+    bool sleeps = false;
     for (size_t i = 0; i < k * n; ++i) {
-        scanf("%lld", &matrix[i].value);
-        scanf("%d", &matrix[i].sleep_time);
+        values[i] = read_number_or_exit(&reader);
+        sleep_times[i] = (int)read_number_or_exit(&reader);
+        sleeps = sleeps || sleep_times[i] != 0;
+    }
+
+    // Without sleeps the chain of block actors is faster than the parallel mode.
+    if (parallel && sleeps) {
+        run_parallel(k, n, values, sleep_times);
+        free(sleep_times);
+        free(values);
+        return 0;
     }
 
     row_t *rows = malloc(k * sizeof(row_t));
@@ -156,16 +649,29 @@ int main(){
     }
 
     mat_t mat;
-    mat.matrix = matrix;
+    mat.values = values;
+    mat.sleep_times = sleep_times;
     mat.row_sums = rows;
     mat.n = n;
     mat.k = k;
     mat.column = 0;
+    mat.columns = 1;
+    mat.rows = 1;
     mat.read_val = read_and_sum;
 
+    if (!sleeps) {
+        mat.columns = BLOCK_COLUMNS;
+        // Batches are large enough that mailboxes of actors never overflow.
+        mat.rows = (k + ACTOR_QUEUE_LIMIT / 2 - 1) / (ACTOR_QUEUE_LIMIT / 2);
+        if (mat.rows < BLOCK_ROWS)
+            mat.rows = BLOCK_ROWS;
+        mat.read_val = sum_block;
+    }
+    mat.stream = NULL;
+
     role_t first_actor_role;
     first_actor_role.prompts = prompts_first_actor;
-    first_actor_role.nprompts = 4;
+    first_actor_role.nprompts = 3;
     if (actor_system_create(&actor, &first_actor_role) != 0)
         exit(1);
 
@@ -175,5 +681,6 @@ int main(){
     actor_system_join(actor);
 
     free(rows);
-    free(matrix);
+    free(sleep_times);
+    free(values);
 }
@@ -0,0 +1,59 @@
+#include <stddef.h>
+#include "mailbox.h"
+
+void create_mailbox(mailbox_t *mailbox) {
+    atomic_init(&mailbox->stub.next, NULL);
+    atomic_init(&mailbox->tail, &mailbox->stub);
+    mailbox->head = &mailbox->stub;
+}
+
+void mailbox_push(mailbox_t *mailbox, mailbox_node_t *node) {
+    mailbox_push_chain(mailbox, node, node);
+}
+
+void mailbox_push_chain(mailbox_t *mailbox, mailbox_node_t *first, mailbox_node_t *last) {
+    atomic_store_explicit(&last->next, NULL, memory_order_relaxed);
+
+    // After the exchange [last] is reachable for other producers, but the chain is not
+    // reachable for the consumer until [prev] is linked to [first].
+    mailbox_node_t *prev = atomic_exchange_explicit(&mailbox->tail, last, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, first, memory_order_release);
+}
+
+bool mailbox_empty(mailbox_t *mailbox) {
+    return mailbox->head == &mailbox->stub &&
+           atomic_load_explicit(&mailbox->stub.next, memory_order_acquire) == NULL;
+}
+
+mailbox_node_t *mailbox_pop(mailbox_t *mailbox) {
+    mailbox_node_t *head = mailbox->head;
+    mailbox_node_t *next = atomic_load_explicit(&head->next, memory_order_acquire);
+
+    if (head == &mailbox->stub) {
+        if (next == NULL)
+            return NULL;
+
+        mailbox->head = next;
+        head = next;
+        next = atomic_load_explicit(&head->next, memory_order_acquire);
+    }
+
+    if (next != NULL) {
+        mailbox->head = next;
+        return head;
+    }
+
+    // [head] is the last node, it can be returned only after the stub takes its place.
+    if (head != atomic_load_explicit(&mailbox->tail, memory_order_acquire))
+        return NULL;
+
+    mailbox_push(mailbox, &mailbox->stub);
+
+    next = atomic_load_explicit(&head->next, memory_order_acquire);
+    if (next != NULL) {
+        mailbox->head = next;
+        return head;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef CACTI_MAILBOX_H
+#define CACTI_MAILBOX_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Intrusive many-producer, single-consumer queue. Nodes are embedded in the queued
+// elements, so pushing never allocates.
+typedef struct mailbox_node {
+    _Atomic(struct mailbox_node *) next;
+} mailbox_node_t;
+
+typedef struct mailbox {
+    _Atomic(mailbox_node_t *) tail;     // Written by producers.
+    mailbox_node_t *head;               // Owned by the consumer.
+    mailbox_node_t stub;
+} mailbox_t;
+
+void create_mailbox(mailbox_t *mailbox);
+
+// May be called concurrently by any number of threads.
+void mailbox_push(mailbox_t *mailbox, mailbox_node_t *node);
+
+// Pushes nodes from [first] to [last], already linked by their [next] fields, at once.
+// Other producers cannot interleave them.
+void mailbox_push_chain(mailbox_t *mailbox, mailbox_node_t *first, mailbox_node_t *last);
+
+// Must be called by the consumer. Returns true if there is no node to pop, apart from
+// ones whose producers have not finished their push yet.
+bool mailbox_empty(mailbox_t *mailbox);
+
+// Must be called by one thread at a time. Returns NULL if the mailbox is empty or if
+// the newest producer has not finished its push yet.
+mailbox_node_t *mailbox_pop(mailbox_t *mailbox);
+
+#endif //CACTI_MAILBOX_H
@@ -1,11 +1,21 @@
 #include "cacti.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
-#define MSG_MEET_CHILD 1
-#define MSG_COMPUTE 2
-#define MSG_KYS 3
-#define MSG_GETDATA 4
+#define MSG_COMPUTE 1
+#define MSG_KYS 2
+#define MSG_GETDATA 3
+#define MSG_RESULT 2
+
+// Largest n whose factorial fits in [factorial_type].
+#define FACTORIAL_MAX 20
+// Ranges of at most [TREE_LEAF] factors are multiplied by one actor.
+#define TREE_LEAF 64
+#define BIGINT_BASE 1000000000u
+// Products of numbers with fewer limbs are computed by schoolbook multiplication.
+#define KARATSUBA_LIMBS 32
 
 typedef long long factorial_type;
 
@@ -22,31 +32,66 @@ typedef struct state {
     actor_id_t child_id;
 } state_t;
 
-void hello(void **stateptr, size_t nbytes, void *data);
-void hello_first_actor( __attribute__((unused))void **stateptr,  __attribute__((unused))size_t nbytes,
+// Unsigned integer in base [BIGINT_BASE], least significant limb first.
+typedef struct bigint {
+    size_t length;
+    size_t capacity;
+    uint32_t limbs[];
+} bigint_t;
+
+typedef struct range {
+    factorial_type from;
+    factorial_type to;
+} range_t;
+
+// Above [FACTORIAL_MAX] every actor of a binary tree multiplies a range of factors. Ranges
+// longer than [TREE_LEAF] are split between two children and their products are multiplied.
+// Children get their ranges with actor_ask_reply, so products are replies to them.
+typedef struct tree_state {
+    range_t range;
+    range_t halves[2];      // Ranges of children, kept until they are handled.
+    bool replies;           // False in the first actor, which prints the product.
+    actor_reply_t reply;
+    actor_id_t my_id;
+    size_t results;         // Number of children which sent their products.
+    bigint_t *product;
+} tree_state_t;
+
+void hello( __attribute__((unused))void **stateptr,  __attribute__((unused))size_t nbytes,
         __attribute__((unused))void *data);
 void get_data(void **stateptr, size_t nbytes, void *data);
-void meet_your_child(void **stateptr, size_t nbytes, void *data);
 void compute(void **stateptr, size_t nbytes, void *data);
 void kill_yourself(void **stateptr, size_t nbytes, void *data);
+void get_range(void **stateptr, size_t nbytes, void *data);
+void compute_range(void **stateptr, size_t nbytes, void *data);
+void tree_result(void **stateptr, size_t nbytes, void *data);
 
-act_t prompts[4] = {hello, meet_your_child, compute, kill_yourself};
-act_t prompts_first_actor[5] = {hello_first_actor, meet_your_child, compute, kill_yourself, get_data};
+// Children are created with their states by actor_spawn, so only the first actor gets
+// MSG_HELLO.
+act_t prompts[3] = {hello, compute, kill_yourself};
+act_t prompts_first_actor[4] = {hello, compute, kill_yourself, get_data};
+act_t prompts_tree[3] = {hello, compute_range, tree_result};
+act_t prompts_tree_first_actor[4] = {hello, compute_range, tree_result, get_range};
 
-role_t role = {.prompts = prompts, .nprompts = 4};
+role_t role = {.prompts = prompts, .nprompts = 3};
+role_t tree_role = {.prompts = prompts_tree, .nprompts = 3};
 
-void hello(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
-    *stateptr = malloc(sizeof(state_t));
-    ((state_t *)(*stateptr))->father_id = (actor_id_t)data;
-    ((state_t *)(*stateptr))->my_id = actor_id_self();
+void hello( __attribute__((unused))void **stateptr,
+        __attribute__((unused))size_t nbytes,  __attribute__((unused))void *data) {}
 
-    send_message(((state_t *)(*stateptr))->father_id,
-            (message_t){.message_type = MSG_MEET_CHILD, .nbytes = sizeof(actor_id_t),
-                        .data = &((state_t *)(*stateptr))->my_id});
-}
+// Creates the actor of the next factor and sends it the factorial computed so far.
+static void spawn_child(state_t *state) {
+    state_t *child = malloc(sizeof(state_t));
+    if (child == NULL)
+        exit(1);
+    child->father_id = state->my_id;
 
-void hello_first_actor( __attribute__((unused))void **stateptr,
-        __attribute__((unused))size_t nbytes,  __attribute__((unused))void *data) {}
+    if (actor_spawn(&role, child, &child->my_id) != 0)
+        exit(1);
+    state->child_id = child->my_id;
+
+    send_message_inline(state->child_id, MSG_COMPUTE, &state->f, sizeof(factorial_t));
+}
 
 void get_data(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
     *stateptr = malloc(sizeof(state_t));
@@ -56,17 +101,7 @@ void get_data(void **stateptr, __attribute__((unused))size_t nbytes, void *data)
     ((state_t *)(*stateptr))->my_id = actor_id_self();
     ((state_t *)(*stateptr))->father_id = ((state_t *)(*stateptr))->my_id;
 
-    send_message(((state_t *)(*stateptr))->my_id,
-            (message_t){.message_type = MSG_SPAWN, .nbytes = sizeof(role_t),
-                        .data = &role});
-}
-
-void meet_your_child(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
-    ((state_t *)(*stateptr))->child_id = *((actor_id_t *)data);
-
-    send_message(((state_t *)(*stateptr))->child_id,
-                 (message_t){.message_type = MSG_COMPUTE, .nbytes = sizeof(factorial_t),
-                             .data = &((state_t *)(*stateptr))->f});
+    spawn_child(*stateptr);
 }
 
 void kill_yourself(void **stateptr, __attribute__((unused))size_t nbytes,
@@ -94,12 +129,264 @@ void compute(void **stateptr, __attribute__((unused))size_t nbytes, void *data)
                      (message_t){.message_type = MSG_KYS, .nbytes = 0, .data = NULL});
     }
     else {
-        send_message(((state_t *)(*stateptr))->my_id,
-                (message_t){.message_type = MSG_SPAWN, .nbytes = sizeof(role_t),
-                                                                  .data = &role});
+        spawn_child(*stateptr);
     }
 }
 
+static bigint_t *create_bigint(size_t capacity) {
+    bigint_t *number = malloc(sizeof(bigint_t) + capacity * sizeof(uint32_t));
+    if (number == NULL)
+        exit(1);
+
+    number->length = 0;
+    number->capacity = capacity;
+    return number;
+}
+
+static bigint_t *multiply_small(bigint_t *number, uint64_t factor) {
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i < number->length; ++i) {
+        carry += (uint64_t)number->limbs[i] * factor;
+        number->limbs[i] = (uint32_t)(carry % BIGINT_BASE);
+        carry /= BIGINT_BASE;
+    }
+
+    while (carry != 0) {
+        if (number->length == number->capacity) {
+            number->capacity *= 2;
+            number = realloc(number, sizeof(bigint_t) + number->capacity * sizeof(uint32_t));
+            if (number == NULL)
+                exit(1);
+        }
+
+        number->limbs[number->length++] = (uint32_t)(carry % BIGINT_BASE);
+        carry /= BIGINT_BASE;
+    }
+
+    return number;
+}
+
+static bigint_t *multiply_range(range_t range) {
+    bigint_t *product = create_bigint(8);
+    product->limbs[0] = 1;
+    product->length = 1;
+
+    for (factorial_type factor = range.from; factor <= range.to; ++factor)
+        product = multiply_small(product, (uint64_t)factor);
+
+    return product;
+}
+
+// Writes the product of [a] and [b] to [alength] + [blength] limbs of [product].
+static void multiply_schoolbook(uint32_t *product, const uint32_t *a, size_t alength,
+                                const uint32_t *b, size_t blength) {
+    memset(product, 0, (alength + blength) * sizeof(uint32_t));
+
+    for (size_t i = 0; i < alength; ++i) {
+        uint64_t carry = 0;
+
+        for (size_t j = 0; j < blength; ++j) {
+            carry += product[i + j] + (uint64_t)a[i] * b[j];
+            product[i + j] = (uint32_t)(carry % BIGINT_BASE);
+            carry /= BIGINT_BASE;
+        }
+
+        for (size_t j = i + blength; carry != 0; ++j) {
+            carry += product[j];
+            product[j] = (uint32_t)(carry % BIGINT_BASE);
+            carry /= BIGINT_BASE;
+        }
+    }
+}
+
+// Writes [a] + [b] to [alength] limbs of [sum], where [alength] >= [blength]. Returns the
+// carry out of the last limb.
+static uint32_t add_limbs(uint32_t *sum, const uint32_t *a, size_t alength, const uint32_t *b,
+                          size_t blength) {
+    uint32_t carry = 0;
+
+    for (size_t i = 0; i < alength; ++i) {
+        uint32_t limb = a[i] + carry + (i < blength ? b[i] : 0);
+        carry = limb >= BIGINT_BASE;
+        sum[i] = carry ? limb - BIGINT_BASE : limb;
+    }
+
+    return carry;
+}
+
+// Adds [a] to [target], which has room for the result.
+static void add_to(uint32_t *target, const uint32_t *a, size_t alength) {
+    uint32_t carry = 0;
+
+    for (size_t i = 0; i < alength || carry != 0; ++i) {
+        uint32_t limb = target[i] + carry + (i < alength ? a[i] : 0);
+        carry = limb >= BIGINT_BASE;
+        target[i] = carry ? limb - BIGINT_BASE : limb;
+    }
+}
+
+// Subtracts [a] from [target], which is not smaller.
+static void subtract_from(uint32_t *target, const uint32_t *a, size_t alength) {
+    uint32_t borrow = 0;
+
+    for (size_t i = 0; i < alength || borrow != 0; ++i) {
+        uint32_t subtrahend = borrow + (i < alength ? a[i] : 0);
+        borrow = target[i] < subtrahend;
+        target[i] = borrow ? target[i] + BIGINT_BASE - subtrahend : target[i] - subtrahend;
+    }
+}
+
+// Writes the product of [a] and [b] to [alength] + [blength] limbs of [product]. Factors
+// of at least [KARATSUBA_LIMBS] limbs are split at [half] limbs into a = a1 * B^half + a0
+// and b = b1 * B^half + b0, and the product is computed from three half-size products:
+// a0 * b0, a1 * b1 and (a0 + a1) * (b0 + b1), from which the other two are subtracted.
+static void multiply_karatsuba(uint32_t *product, const uint32_t *a, size_t alength,
+                               const uint32_t *b, size_t blength) {
+    if (alength < blength) {
+        multiply_karatsuba(product, b, blength, a, alength);
+        return;
+    }
+
+    if (blength < KARATSUBA_LIMBS) {
+        multiply_schoolbook(product, a, alength, b, blength);
+        return;
+    }
+
+    size_t half = (alength + 1) / 2;
+    size_t length = alength + blength;
+
+    // [b] has no upper half, so each half of [a] is multiplied by it.
+    if (blength <= half) {
+        uint32_t *upper = malloc((length - half) * sizeof(uint32_t));
+        if (upper == NULL)
+            exit(1);
+
+        multiply_karatsuba(product, a, half, b, blength);
+        memset(product + half + blength, 0, (alength - half) * sizeof(uint32_t));
+        multiply_karatsuba(upper, a + half, alength - half, b, blength);
+        add_to(product + half, upper, length - half);
+
+        free(upper);
+        return;
+    }
+
+    uint32_t *sums = malloc((4 * half + 4) * sizeof(uint32_t));
+    if (sums == NULL)
+        exit(1);
+    uint32_t *asum = sums, *bsum = sums + half + 1, *middle = sums + 2 * half + 2;
+
+    multiply_karatsuba(product, a, half, b, half);
+    multiply_karatsuba(product + 2 * half, a + half, alength - half, b + half, blength - half);
+
+    asum[half] = add_limbs(asum, a, half, a + half, alength - half);
+    bsum[half] = add_limbs(bsum, b, half, b + half, blength - half);
+    multiply_karatsuba(middle, asum, half + 1, bsum, half + 1);
+    subtract_from(middle, product, 2 * half);
+    subtract_from(middle, product + 2 * half, length - 2 * half);
+
+    size_t middle_length = 2 * half + 2;
+    while (middle_length > 0 && middle[middle_length - 1] == 0)
+        --middle_length;
+    add_to(product + half, middle, middle_length);
+
+    free(sums);
+}
+
+static bigint_t *multiply(const bigint_t *a, const bigint_t *b) {
+    bigint_t *product = create_bigint(a->length + b->length);
+    product->length = a->length + b->length;
+    multiply_karatsuba(product->limbs, a->limbs, a->length, b->limbs, b->length);
+
+    while (product->length > 1 && product->limbs[product->length - 1] == 0)
+        --product->length;
+
+    return product;
+}
+
+static void print_bigint(const bigint_t *number) {
+    printf("%u", number->limbs[number->length - 1]);
+    for (size_t i = number->length - 1; i > 0; --i)
+        printf("%09u", number->limbs[i - 1]);
+}
+
+// Replies to the father with the product of the actor's range, or prints it in the first
+// actor.
+static void finish_range(void **stateptr) {
+    tree_state_t *state = *stateptr;
+    actor_id_t my_id = state->my_id;
+
+    if (state->replies) {
+        actor_send_reply(&state->reply, (message_t){.nbytes = sizeof(bigint_t *),
+                                                    .data = state->product});
+    }
+    else {
+        print_bigint(state->product);
+        free(state->product);
+    }
+
+    free(state);
+    send_message(my_id, (message_t){.message_type = MSG_GODIE, .nbytes = 0, .data = NULL});
+}
+
+void get_range(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    *stateptr = calloc(1, sizeof(tree_state_t));
+    if (*stateptr == NULL)
+        exit(1);
+    ((tree_state_t *)(*stateptr))->my_id = actor_id_self();
+
+    compute_range(stateptr, sizeof(range_t), data);
+}
+
+void compute_range(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    tree_state_t *state = *stateptr;
+    state->range = *(range_t *)data;
+    // Range given with a plain message comes to the first actor from main.
+    state->replies = actor_defer_reply(&state->reply) == 0;
+
+    if (state->range.to - state->range.from < TREE_LEAF) {
+        state->product = multiply_range(state->range);
+        finish_range(stateptr);
+        return;
+    }
+
+    factorial_type middle = state->range.from + (state->range.to - state->range.from) / 2;
+    state->halves[0] = (range_t){.from = state->range.from, .to = middle};
+    state->halves[1] = (range_t){.from = middle + 1, .to = state->range.to};
+
+    for (int i = 0; i < 2; ++i) {
+        tree_state_t *child = calloc(1, sizeof(tree_state_t));
+        if (child == NULL)
+            exit(1);
+
+        actor_id_t child_id;
+        if (actor_spawn(&tree_role, child, &child_id) != 0)
+            exit(1);
+        child->my_id = child_id;
+
+        actor_ask_reply(child_id, (message_t){.message_type = MSG_COMPUTE,
+                                              .nbytes = sizeof(range_t),
+                                              .data = &state->halves[i]},
+                        MSG_RESULT);
+    }
+}
+
+void tree_result(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    tree_state_t *state = *stateptr;
+
+    if (state->results++ == 0) {
+        state->product = data;
+        return;
+    }
+
+    bigint_t *product = multiply(state->product, data);
+    free(state->product);
+    free(data);
+    state->product = product;
+
+    finish_range(stateptr);
+}
+
 int main(){
     actor_id_t actor;
     factorial_type num;
@@ -111,10 +398,26 @@ int main(){
     if (num == 0 || num == 1) {
         printf("%d", 1);
     }
+    // Factorials above [FACTORIAL_MAX] are computed in a tree of actors.
+    else if (num > FACTORIAL_MAX) {
+        if (num >= BIGINT_BASE)
+            exit(1);
+
+        role_t first_actor_role;
+        first_actor_role.prompts = prompts_tree_first_actor;
+        first_actor_role.nprompts = 4;
+        if (actor_system_create(&actor, &first_actor_role) != 0)
+            exit(1);
+
+        range_t range = {.from = 2, .to = num};
+        send_message_inline(actor, MSG_GETDATA, &range, sizeof(range_t));
+
+        actor_system_join(actor);
+    }
     else {
         role_t first_actor_role;
         first_actor_role.prompts = prompts_first_actor;
-        first_actor_role.nprompts = 5;
+        first_actor_role.nprompts = 4;
         if (actor_system_create(&actor, &first_actor_role) != 0)
             exit(1);
 
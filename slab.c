@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include "slab.h"
+
+#define SLAB_OBJECTS 256
+#define SLAB_ALIGNMENT 64
+
+struct slab_object {
+    slab_pool_t *pool;
+    // Object's memory follows. It holds the free list link while the object is unused.
+    union {
+        slab_object_t *next;
+        max_align_t align;
+    } data;
+};
+
+// Takes the first cache line of its memory. Headers of objects end at cache line boundaries,
+// so memory of each object starts at one.
+struct slab {
+    slab_t *next;
+};
+
+_Static_assert(sizeof(slab_t) + offsetof(slab_object_t, data) <= SLAB_ALIGNMENT,
+               "slab header does not fit before the first object");
+
+static size_t object_stride(slab_pool_t *pool) {
+    size_t stride = offsetof(slab_object_t, data) + pool->object_size;
+
+    if (stride < sizeof(slab_object_t))
+        stride = sizeof(slab_object_t);
+
+    return (stride + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT * SLAB_ALIGNMENT;
+}
+
+static int add_slab(slab_pool_t *pool) {
+    size_t stride = object_stride(pool);
+    slab_t *slab = aligned_alloc(SLAB_ALIGNMENT, SLAB_ALIGNMENT + SLAB_OBJECTS * stride);
+    if (slab == NULL)
+        return -1;
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+
+    char *memory = (char *)slab + SLAB_ALIGNMENT - offsetof(slab_object_t, data);
+    for (size_t i = 0; i < SLAB_OBJECTS; ++i) {
+        slab_object_t *object = (slab_object_t *)(memory + i * stride);
+        object->pool = pool;
+        object->data.next = pool->free_objects;
+        pool->free_objects = object;
+    }
+
+    return 0;
+}
+
+void create_slab_pool(slab_pool_t *pool, size_t object_size) {
+    pool->object_size = object_size;
+    pool->free_objects = NULL;
+    atomic_init(&pool->returned_objects, NULL);
+    pool->slabs = NULL;
+}
+
+void *slab_alloc(slab_pool_t *pool) {
+    if (pool->free_objects == NULL) {
+        // Taking the whole list at once is not prone to ABA problem.
+        pool->free_objects = atomic_exchange(&pool->returned_objects, NULL);
+
+        if (pool->free_objects == NULL && add_slab(pool) != 0)
+            return NULL;
+    }
+
+    slab_object_t *object = pool->free_objects;
+    pool->free_objects = object->data.next;
+
+    return &object->data;
+}
+
+void slab_free(slab_pool_t *caller_pool, void *object) {
+    slab_object_t *header = (slab_object_t *)((char *)object - offsetof(slab_object_t, data));
+    slab_pool_t *pool = header->pool;
+
+    if (pool == caller_pool) {
+        header->data.next = pool->free_objects;
+        pool->free_objects = header;
+        return;
+    }
+
+    slab_object_t *head = atomic_load_explicit(&pool->returned_objects, memory_order_relaxed);
+    do {
+        header->data.next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->returned_objects, &head, header,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+void delete_slab_pool(slab_pool_t *pool) {
+    while (pool->slabs != NULL) {
+        slab_t *next = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next;
+    }
+
+    pool->free_objects = NULL;
+    atomic_store(&pool->returned_objects, NULL);
+}
@@ -0,0 +1,31 @@
+#ifndef CACTI_SLAB_H
+#define CACTI_SLAB_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+typedef struct slab_object slab_object_t;
+typedef struct slab slab_t;
+
+// Pool of fixed-size objects. Objects are taken only by the pool owner, but may be
+// returned by any thread. Each object starts at a cache line boundary.
+typedef struct slab_pool {
+    size_t object_size;
+    slab_object_t *free_objects;                // Owned by the pool owner.
+    _Atomic(slab_object_t *) returned_objects;  // Objects returned by other threads.
+    slab_t *slabs;
+} slab_pool_t;
+
+void create_slab_pool(slab_pool_t *pool, size_t object_size);
+
+// Must be called by the pool owner. Returns NULL if memory cannot be allocated.
+void *slab_alloc(slab_pool_t *pool);
+
+// Returns [object] to the pool it was taken from. [caller_pool] is the pool owned by the
+// calling thread or NULL.
+void slab_free(slab_pool_t *caller_pool, void *object);
+
+// Frees all slabs, including objects which were not returned.
+void delete_slab_pool(slab_pool_t *pool);
+
+#endif //CACTI_SLAB_H
@@ -0,0 +1,184 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "cacti.h"
+#include "test.h"
+
+// Replies reach futures and askers exactly once, and futures of messages released without
+// a reply are broken.
+
+#define MSG_DOUBLE 1
+#define MSG_SILENT 2
+#define MSG_DEFER 3
+#define MSG_ANSWER 4
+#define MSG_UNHANDLED 5
+
+#define MSG_ASK 1
+#define MSG_RESULT 2
+
+#define ASKS 100
+#define DEFERRED_ANSWER 77
+
+static actor_reply_t deferred;
+
+static void nothing(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+                    __attribute__((unused))void *data) {
+}
+
+static void server_double(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes, void *data) {
+    message_t reply = {.message_type = MSG_RESULT, .nbytes = 0,
+                       .data = (void *)((uintptr_t)data * 2)};
+
+    CHECK(actor_reply(reply) == 0);
+    CHECK(actor_reply(reply) == -1);
+}
+
+static void server_defer(__attribute__((unused))void **stateptr,
+                         __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    CHECK(actor_defer_reply(&deferred) == 0);
+    CHECK(actor_defer_reply(&deferred) == -1);
+}
+
+// Sent without actor_ask, so it cannot be replied to itself.
+static void server_answer(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    message_t answer = {.message_type = MSG_RESULT, .nbytes = 0,
+                        .data = (void *)(uintptr_t)DEFERRED_ANSWER};
+
+    CHECK(actor_reply(answer) == -1);
+    CHECK(actor_send_reply(&deferred, answer) == 0);
+}
+
+static act_t server_prompts[] = {nothing, server_double, nothing, server_defer, server_answer};
+static role_t server_role = {.nprompts = 5, .prompts = server_prompts};
+
+static actor_id_t server;
+static atomic_int results;
+static atomic_bool asker_done;
+
+// Waits for a future of its own, which lets the only worker run the server meanwhile, and
+// then asks for replies sent as messages.
+static void asker_ask(__attribute__((unused))void **stateptr,
+                      __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    actor_future_t *future;
+    message_t reply;
+
+    CHECK(actor_ask(server, (message_t){.message_type = MSG_DOUBLE, .nbytes = 0,
+                                         .data = (void *)21}, &future) == 0);
+    CHECK(actor_future_wait(future, &reply) == 0);
+    CHECK((uintptr_t)reply.data == 42);
+    actor_future_free(future);
+
+    for (uintptr_t i = 0; i < ASKS; ++i) {
+        CHECK(actor_ask_reply(server, (message_t){.message_type = MSG_DOUBLE, .nbytes = 0,
+                                                  .data = (void *)i}, MSG_RESULT) == 0);
+    }
+    // Not handled by the server, so no reply comes.
+    CHECK(actor_ask_reply(server, (message_t){.message_type = MSG_SILENT, .nbytes = 0,
+                                              .data = NULL}, MSG_RESULT) == 0);
+}
+
+static void asker_result(__attribute__((unused))void **stateptr,
+                         __attribute__((unused))size_t nbytes, void *data) {
+    static uintptr_t sum;
+
+    sum += (uintptr_t)data;
+    if (atomic_fetch_add(&results, 1) + 1 == ASKS) {
+        CHECK(sum == ASKS * (ASKS - 1));
+        atomic_store(&asker_done, true);
+    }
+}
+
+static act_t asker_prompts[] = {nothing, asker_ask, asker_result};
+static role_t asker_role = {.nprompts = 3, .prompts = asker_prompts};
+
+static void test_reply(actor_system_t *system) {
+    actor_future_t *future;
+    message_t reply;
+
+    CHECK(actor_ask_to(system, server, (message_t){.message_type = MSG_DOUBLE, .nbytes = 0,
+                                                   .data = (void *)5}, &future) == 0);
+    CHECK(actor_future_wait(future, &reply) == 0);
+    CHECK(reply.message_type == MSG_RESULT);
+    CHECK((uintptr_t)reply.data == 10);
+    // The reply stays in the future.
+    CHECK(actor_future_try(future, &reply) == 0);
+    CHECK((uintptr_t)reply.data == 10);
+    actor_future_free(future);
+
+    CHECK(actor_ask_reply(server, (message_t){.message_type = MSG_DOUBLE, .nbytes = 0,
+                                              .data = NULL}, MSG_RESULT) == -5);
+}
+
+static void test_broken(actor_system_t *system) {
+    message_type_t types[] = {MSG_SILENT, MSG_UNHANDLED};
+    actor_future_t *future;
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        CHECK(actor_ask_to(system, server, (message_t){.message_type = types[i], .nbytes = 0,
+                                                       .data = NULL}, &future) == 0);
+        CHECK(actor_future_wait(future, NULL) == -1);
+        actor_future_free(future);
+    }
+}
+
+static void test_deferred(actor_system_t *system) {
+    actor_future_t *future;
+    message_t reply;
+
+    CHECK(actor_ask_to(system, server, (message_t){.message_type = MSG_DEFER, .nbytes = 0,
+                                                   .data = NULL}, &future) == 0);
+    CHECK(actor_future_try(future, &reply) == 1);
+
+    CHECK(send_message_to(system, server, (message_t){.message_type = MSG_ANSWER, .nbytes = 0,
+                                                      .data = NULL}) == 0);
+    CHECK(actor_future_wait(future, &reply) == 0);
+    CHECK((uintptr_t)reply.data == DEFERRED_ANSWER);
+    actor_future_free(future);
+}
+
+static void test_in_handler(actor_system_t *system) {
+    actor_id_t asker;
+    CHECK(actor_spawn_to(system, &asker_role, NULL, &asker) == 0);
+    CHECK(send_message_to(system, asker, (message_t){.message_type = MSG_ASK, .nbytes = 0,
+                                                     .data = NULL}) == 0);
+
+    struct timespec millisecond = {.tv_sec = 0, .tv_nsec = 1000000};
+    for (int ms = 0; !atomic_load(&asker_done) && ms < 5000; ++ms)
+        nanosleep(&millisecond, NULL);
+
+    CHECK(atomic_load(&asker_done));
+    CHECK(atomic_load(&results) == ASKS);
+    CHECK(send_message_to(system, asker, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                                     .data = NULL}) == 0);
+}
+
+// The server dies with the message it is asked, so the future is broken.
+static void test_dead_replier(actor_system_t *system) {
+    actor_future_t *future;
+
+    CHECK(actor_ask_to(system, server, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                                   .data = NULL}, &future) == 0);
+    CHECK(actor_future_wait(future, NULL) == -1);
+    actor_future_free(future);
+}
+
+int main() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+
+    actor_system_t *system;
+    CHECK(actor_system_start(&system, &server, &server_role, &config) == 0);
+
+    test_reply(system);
+    test_broken(system);
+    test_deferred(system);
+    test_in_handler(system);
+    test_dead_replier(system);
+
+    actor_system_wait(system);
+    return 0;
+}
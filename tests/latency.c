@@ -0,0 +1,140 @@
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "test.h"
+
+// Histograms count queueing and handler times of each message type, if the library keeps
+// them at all.
+
+#define MSG_FAST 1
+#define MSG_SLOW 2
+
+#define FAST_MESSAGES 100
+#define SLOW_MESSAGES 5
+#define SLOW_NS 2000000ULL
+
+#define WAIT_MS 5000
+
+#ifdef CACTI_LATENCY
+static const bool histograms = true;
+#else
+static const bool histograms = false;
+#endif
+
+static atomic_int handled;
+
+static void sleep_ns(unsigned long long ns) {
+    struct timespec duration = {.tv_sec = (time_t)(ns / 1000000000ULL),
+                                .tv_nsec = (long)(ns % 1000000000ULL)};
+    nanosleep(&duration, NULL);
+}
+
+static void nothing(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+                    __attribute__((unused))void *data) {
+}
+
+static void fast(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+                 __attribute__((unused))void *data) {
+    atomic_fetch_add(&handled, 1);
+}
+
+static void slow(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+                 __attribute__((unused))void *data) {
+    sleep_ns(SLOW_NS);
+    atomic_fetch_add(&handled, 1);
+}
+
+static act_t prompts[] = {nothing, fast, slow};
+static role_t role = {.nprompts = 3, .prompts = prompts};
+
+typedef struct latency_line
+{
+    unsigned long long queue_count;
+    unsigned long long handler_count;
+    unsigned long long handler_p50;
+} latency_line_t;
+
+// Finds the line of [message_type] for all workers together in the output of
+// actor_system_latency_print. Returns false if there is none.
+static bool read_line(actor_system_t *system, message_type_t message_type,
+                      latency_line_t *line) {
+    FILE *file = tmpfile();
+    CHECK(file != NULL);
+    CHECK(actor_system_latency_print(system, fileno(file)) == 0);
+    rewind(file);
+
+    char buffer[1024];
+    bool found = false;
+    while (!found && fgets(buffer, sizeof(buffer), file) != NULL) {
+        void *prompts;
+        long type;
+        unsigned long long skipped;
+
+        found = strncmp(buffer, "all ", 4) == 0 &&
+                sscanf(buffer, "all role %p type %ld queue_ns count %llu p50 %llu p90 %llu "
+                               "p99 %llu p999 %llu max %llu handler_ns count %llu p50 %llu",
+                       &prompts, &type, &line->queue_count, &skipped, &skipped, &skipped,
+                       &skipped, &skipped, &line->handler_count, &line->handler_p50) == 10 &&
+                prompts == (void *)role.prompts && type == message_type;
+    }
+
+    fclose(file);
+    return found;
+}
+
+static void check_latency(actor_system_t *system) {
+    if (!histograms) {
+        CHECK(actor_system_latency_print(system, STDOUT_FILENO) == -1);
+        return;
+    }
+
+    latency_line_t fast_line = {0}, slow_line = {0};
+
+    // Times are recorded after handlers return, so the last ones may still be missing.
+    for (int ms = 0; ms < WAIT_MS; ++ms) {
+        if (read_line(system, MSG_FAST, &fast_line) && read_line(system, MSG_SLOW, &slow_line) &&
+            fast_line.handler_count == FAST_MESSAGES && slow_line.handler_count == SLOW_MESSAGES)
+            break;
+        sleep_ns(1000000);
+    }
+
+    CHECK(fast_line.queue_count == FAST_MESSAGES);
+    CHECK(fast_line.handler_count == FAST_MESSAGES);
+    CHECK(slow_line.queue_count == SLOW_MESSAGES);
+    CHECK(slow_line.handler_count == SLOW_MESSAGES);
+    CHECK(slow_line.handler_p50 >= SLOW_NS);
+}
+
+int main() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+
+    actor_system_t *system;
+    actor_id_t actor;
+    CHECK(actor_system_start(&system, &actor, &role, &config) == 0);
+
+    for (size_t i = 0; i < FAST_MESSAGES; ++i) {
+        CHECK(send_message_to(system, actor, (message_t){.message_type = MSG_FAST, .nbytes = 0,
+                                                         .data = NULL}) == 0);
+    }
+    for (size_t i = 0; i < SLOW_MESSAGES; ++i) {
+        CHECK(send_message_to(system, actor, (message_t){.message_type = MSG_SLOW, .nbytes = 0,
+                                                         .data = NULL}) == 0);
+    }
+
+    for (int ms = 0; atomic_load(&handled) < FAST_MESSAGES + SLOW_MESSAGES && ms < WAIT_MS; ++ms)
+        sleep_ns(1000000);
+    CHECK(atomic_load(&handled) == FAST_MESSAGES + SLOW_MESSAGES);
+
+    check_latency(system);
+
+    CHECK(send_message_to(system, actor, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                                     .data = NULL}) == 0);
+    actor_system_wait(system);
+
+    return 0;
+}
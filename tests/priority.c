@@ -0,0 +1,160 @@
+#include <stdint.h>
+
+#include "cacti.h"
+#include "test.h"
+
+// Messages of an actor are handled from higher lanes first, lower lanes still get their
+// turns, and an actor waiting in a ready queue is moved up by a message of higher priority.
+
+#define MSG_RECORD 1
+
+#define LANE_MESSAGES 4
+#define BUSY_ACTORS 32
+#define TARGET ((void *)(uintptr_t)-1)
+
+static actor_priority_t order[ACTOR_PRIORITIES * LANE_MESSAGES];
+static size_t recorded;
+
+static void send_priority(actor_id_t actor, actor_priority_t priority) {
+    CHECK(send_message_priority(actor, (message_t){.message_type = MSG_RECORD, .nbytes = 0,
+                                                   .data = (void *)(uintptr_t)priority},
+                                priority) == 0);
+}
+
+static void die() {
+    CHECK(send_message(actor_id_self(), (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                                     .data = NULL}) == 0);
+}
+
+static void run(role_t *role) {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+
+    actor_system_t *system;
+    actor_id_t actor;
+    CHECK(actor_system_start(&system, &actor, role, &config) == 0);
+    actor_system_wait(system);
+}
+
+static void lanes_hello(__attribute__((unused))void **stateptr,
+                        __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    actor_id_t self = actor_id_self();
+    message_t message = {.message_type = MSG_RECORD, .nbytes = 0, .data = NULL};
+
+    CHECK(send_message_priority(self, message, ACTOR_PRIORITIES) == -4);
+    CHECK(send_message_priority(self, message, (actor_priority_t)-1) == -4);
+
+    for (int priority = ACTOR_PRIORITIES - 1; priority >= 0; --priority) {
+        for (size_t i = 0; i < LANE_MESSAGES; ++i)
+            send_priority(self, (actor_priority_t)priority);
+    }
+}
+
+static void lanes_record(__attribute__((unused))void **stateptr,
+                         __attribute__((unused))size_t nbytes, void *data) {
+    order[recorded++] = (actor_priority_t)(uintptr_t)data;
+    if (recorded == ACTOR_PRIORITIES * LANE_MESSAGES)
+        die();
+}
+
+static act_t lanes_prompts[] = {lanes_hello, lanes_record};
+static role_t lanes_role = {.nprompts = 2, .prompts = lanes_prompts};
+
+static void test_lanes() {
+    recorded = 0;
+    run(&lanes_role);
+
+    CHECK(recorded == ACTOR_PRIORITIES * LANE_MESSAGES);
+    for (size_t i = 0; i < recorded; ++i)
+        CHECK(order[i] == (actor_priority_t)(i / LANE_MESSAGES));
+}
+
+static size_t high_before_low;
+static bool low_handled;
+
+static void starvation_hello(__attribute__((unused))void **stateptr,
+                             __attribute__((unused))size_t nbytes,
+                             __attribute__((unused))void *data) {
+    send_priority(actor_id_self(), ACTOR_PRIORITY_LOW);
+    send_priority(actor_id_self(), ACTOR_PRIORITY_HIGH);
+}
+
+// Each high priority message sends the next one, until the low priority one is handled.
+static void starvation_record(__attribute__((unused))void **stateptr,
+                              __attribute__((unused))size_t nbytes, void *data) {
+    if ((actor_priority_t)(uintptr_t)data == ACTOR_PRIORITY_LOW) {
+        low_handled = true;
+    }
+    else if (low_handled) {
+        die();
+    }
+    else {
+        ++high_before_low;
+        send_priority(actor_id_self(), ACTOR_PRIORITY_HIGH);
+    }
+}
+
+static act_t starvation_prompts[] = {starvation_hello, starvation_record};
+static role_t starvation_role = {.nprompts = 2, .prompts = starvation_prompts};
+
+static void test_starvation() {
+    high_before_low = 0;
+    low_handled = false;
+    run(&starvation_role);
+
+    CHECK(low_handled);
+    CHECK(high_before_low < ACTOR_PRIORITY_STARVATION * (ACTOR_PRIORITIES - 1));
+}
+
+static void *handled[BUSY_ACTORS + 2];
+static size_t handled_count;
+static size_t target_messages;
+static role_t promotion_role;
+
+// Fills the ready queue of the only worker with busy actors, then sends the target a low
+// priority message, which queues it behind them, and a high priority one, which has to
+// move it before them.
+static void promotion_hello(__attribute__((unused))void **stateptr,
+                            __attribute__((unused))size_t nbytes,
+                            __attribute__((unused))void *data) {
+    actor_id_t actor;
+
+    for (size_t i = 0; i < BUSY_ACTORS; ++i) {
+        CHECK(actor_spawn(&promotion_role, (void *)(uintptr_t)i, &actor) == 0);
+        send_priority(actor, ACTOR_PRIORITY_NORMAL);
+    }
+
+    CHECK(actor_spawn(&promotion_role, TARGET, &actor) == 0);
+    send_priority(actor, ACTOR_PRIORITY_LOW);
+    send_priority(actor, ACTOR_PRIORITY_HIGH);
+
+    die();
+}
+
+static void promotion_record(void **stateptr, __attribute__((unused))size_t nbytes,
+                             __attribute__((unused))void *data) {
+    handled[handled_count++] = *stateptr;
+    if (*stateptr != TARGET || ++target_messages == 2)
+        die();
+}
+
+static act_t promotion_prompts[] = {promotion_hello, promotion_record};
+static role_t promotion_role = {.nprompts = 2, .prompts = promotion_prompts};
+
+static void test_promotion() {
+    handled_count = 0;
+    target_messages = 0;
+    run(&promotion_role);
+
+    CHECK(handled_count == BUSY_ACTORS + 2);
+    CHECK(handled[0] == TARGET);
+    CHECK(handled[1] == TARGET);
+}
+
+int main() {
+    test_lanes();
+    test_starvation();
+    test_promotion();
+    return 0;
+}
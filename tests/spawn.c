@@ -0,0 +1,112 @@
+#include <stdatomic.h>
+
+#include "cacti.h"
+#include "test.h"
+
+// Actors created with actor_spawn get their state at once and no MSG_HELLO, within the cast
+// limit of a system which has not finished.
+
+#define MSG_CHECK 1
+
+#define CHILDREN 16
+#define CAST_LIMIT_OVERRIDE 3
+
+typedef struct child_state
+{
+    size_t index;
+    atomic_bool checked;
+} child_state_t;
+
+static child_state_t states[CHILDREN + 1];
+static atomic_int checked;
+
+static void godie(actor_id_t actor) {
+    CHECK(send_message(actor, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                          .data = NULL}) == 0);
+}
+
+static void child_hello(__attribute__((unused))void **stateptr,
+                        __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    CHECK(false);
+}
+
+static void child_check(void **stateptr, __attribute__((unused))size_t nbytes, void *data) {
+    child_state_t *state = *stateptr;
+
+    CHECK(state == &states[(size_t)data]);
+    CHECK(!atomic_exchange(&state->checked, true));
+    atomic_fetch_add(&checked, 1);
+    godie(actor_id_self());
+}
+
+static act_t child_prompts[] = {child_hello, child_check};
+static role_t child_role = {.nprompts = 2, .prompts = child_prompts};
+
+static void spawn_child(size_t index) {
+    actor_id_t child;
+
+    CHECK(actor_spawn(&child_role, &states[index], &child) == 0);
+    CHECK(send_message(child, (message_t){.message_type = MSG_CHECK, .nbytes = 0,
+                                          .data = (void *)index}) == 0);
+}
+
+static void parent_hello(__attribute__((unused))void **stateptr,
+                         __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    for (size_t i = 0; i < CHILDREN; ++i)
+        spawn_child(i);
+}
+
+static act_t parent_prompts[] = {parent_hello};
+static role_t parent_role = {.nprompts = 1, .prompts = parent_prompts};
+
+// Children are spawned by the first actor of the default system and by the main thread.
+static void test_spawn() {
+    actor_id_t parent;
+    CHECK(actor_system_create(&parent, &parent_role) == 0);
+
+    spawn_child(CHILDREN);
+    godie(parent);
+    actor_system_join(parent);
+
+    CHECK(atomic_load(&checked) == CHILDREN + 1);
+    for (size_t i = 0; i <= CHILDREN; ++i)
+        CHECK(atomic_load(&states[i].checked));
+
+    // The system has finished.
+    actor_id_t actor;
+    CHECK(actor_spawn(&child_role, NULL, &actor) == -2);
+}
+
+static void limited_hello(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    actor_id_t children[CAST_LIMIT_OVERRIDE], extra;
+
+    for (size_t i = 1; i < CAST_LIMIT_OVERRIDE; ++i)
+        CHECK(actor_spawn(&child_role, NULL, &children[i]) == 0);
+    CHECK(actor_spawn(&child_role, NULL, &extra) == -2);
+
+    for (size_t i = 1; i < CAST_LIMIT_OVERRIDE; ++i)
+        godie(children[i]);
+    godie(actor_id_self());
+}
+
+static act_t limited_prompts[] = {limited_hello};
+static role_t limited_role = {.nprompts = 1, .prompts = limited_prompts};
+
+static void test_cast_limit() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+    config.cast_limit = CAST_LIMIT_OVERRIDE;
+
+    actor_system_t *system;
+    actor_id_t actor;
+    CHECK(actor_system_start(&system, &actor, &limited_role, &config) == 0);
+    actor_system_wait(system);
+}
+
+int main() {
+    test_spawn();
+    test_cast_limit();
+    return 0;
+}
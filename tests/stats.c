@@ -0,0 +1,105 @@
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+#include "cacti.h"
+#include "test.h"
+
+// Snapshots count messages of workers, of the main thread and of each actor, if the library
+// keeps metrics at all.
+
+#define MSG_COUNT 1
+
+#define QUEUE_LIMIT_OVERRIDE 8
+#define POOL_SIZE_OVERRIDE 2
+
+static sem_t release_hello;
+static atomic_bool hello_started;
+static atomic_size_t counted;
+
+// Keeps the actor busy, so messages of the main thread wait in its queue.
+static void blocked_hello(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes,
+                          __attribute__((unused))void *data) {
+    atomic_store(&hello_started, true);
+    CHECK(sem_wait(&release_hello) == 0);
+}
+
+static void count(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+                  __attribute__((unused))void *data) {
+    atomic_fetch_add(&counted, 1);
+}
+
+static act_t prompts[] = {blocked_hello, count};
+static role_t role = {.nprompts = 2, .prompts = prompts};
+
+static void check_stats(actor_system_t *system, actor_id_t actor) {
+    actor_system_stats_t stats;
+
+#ifndef CACTI_METRICS
+    (void)actor;
+    CHECK(actor_system_stats(system, &stats) == -1);
+    actor_system_stats_free(&stats);
+#else
+    CHECK(actor_system_stats(system, &stats) == 0);
+
+    CHECK(stats.queue_limit == QUEUE_LIMIT_OVERRIDE);
+    CHECK(stats.spawns == 1);
+    CHECK(stats.deaths == 0);
+    CHECK(stats.nworkers >= POOL_SIZE_OVERRIDE);
+
+    // MSG_HELLO of the first actor is sent by the main thread as well.
+    CHECK(stats.external.messages_sent == QUEUE_LIMIT_OVERRIDE + 1);
+    CHECK(stats.external.messages_rejected == 1);
+    CHECK(stats.total.messages_processed == QUEUE_LIMIT_OVERRIDE + 1);
+
+    CHECK(stats.nactors == 1);
+    CHECK(stats.actors[0].actor == actor);
+    CHECK(stats.actors[0].messages_processed == QUEUE_LIMIT_OVERRIDE + 1);
+    CHECK(stats.actors[0].messages_rejected == 1);
+    CHECK(stats.actors[0].queued == 0);
+    CHECK(stats.actors[0].queue_high_water == QUEUE_LIMIT_OVERRIDE);
+
+    FILE *file = tmpfile();
+    CHECK(file != NULL);
+    actor_system_stats_print(&stats, fileno(file));
+    CHECK(fseek(file, 0, SEEK_END) == 0 && ftell(file) > 0);
+    fclose(file);
+
+    actor_system_stats_free(&stats);
+    CHECK(stats.workers == NULL && stats.actors == NULL);
+#endif
+}
+
+int main() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = POOL_SIZE_OVERRIDE;
+    config.queue_limit = QUEUE_LIMIT_OVERRIDE;
+
+    CHECK(sem_init(&release_hello, 0, 0) == 0);
+    actor_system_t *system;
+    actor_id_t actor;
+    CHECK(actor_system_start(&system, &actor, &role, &config) == 0);
+
+    while (!atomic_load(&hello_started))
+        sched_yield();
+
+    message_t message = {.message_type = MSG_COUNT, .nbytes = 0, .data = NULL};
+    for (size_t i = 0; i < QUEUE_LIMIT_OVERRIDE; ++i)
+        CHECK(send_message_to(system, actor, message) == 0);
+    CHECK(send_message_to(system, actor, message) == -3);
+
+    CHECK(sem_post(&release_hello) == 0);
+    while (atomic_load(&counted) < QUEUE_LIMIT_OVERRIDE)
+        sched_yield();
+
+    check_stats(system, actor);
+
+    CHECK(send_message_to(system, actor, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                                     .data = NULL}) == 0);
+    actor_system_wait(system);
+    CHECK(sem_destroy(&release_hello) == 0);
+
+    return 0;
+}
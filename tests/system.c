@@ -0,0 +1,253 @@
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "cacti.h"
+#include "test.h"
+
+// Limits of a configuration override the compile-time ones, slots of dead actors are reused
+// under new identifiers, and independent systems run side by side.
+
+#define MSG_COUNT 1
+#define MSG_ACK 2
+#define MSG_CHILD 1
+
+#define QUEUE_LIMIT_OVERRIDE 4
+#define CAST_LIMIT_OVERRIDE 8
+#define RECYCLED_CHILDREN 1000
+#define SYSTEMS 4
+#define SYSTEM_MESSAGES 256
+
+static void godie(actor_id_t actor) {
+    CHECK(send_message(actor, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                          .data = NULL}) == 0);
+}
+
+static actor_system_t *start(role_t *role, const actor_system_config_t *config) {
+    actor_system_t *system;
+    actor_id_t actor;
+
+    CHECK(actor_system_start(&system, &actor, role, config) == 0);
+    return system;
+}
+
+static sem_t release_hello;
+static atomic_bool hello_started;
+static size_t counted;
+
+// Keeps the only worker busy, so messages of the main thread wait in the queue.
+static void blocked_hello(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes,
+                          __attribute__((unused))void *data) {
+    atomic_store(&hello_started, true);
+    CHECK(sem_wait(&release_hello) == 0);
+}
+
+static void blocked_count(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes,
+                          __attribute__((unused))void *data) {
+    if (++counted == QUEUE_LIMIT_OVERRIDE)
+        godie(actor_id_self());
+}
+
+static act_t blocked_prompts[] = {blocked_hello, blocked_count};
+static role_t blocked_role = {.nprompts = 2, .prompts = blocked_prompts};
+
+static void test_queue_limit() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+    config.queue_limit = QUEUE_LIMIT_OVERRIDE;
+
+    CHECK(sem_init(&release_hello, 0, 0) == 0);
+    actor_system_t *system;
+    actor_id_t actor;
+    CHECK(actor_system_start(&system, &actor, &blocked_role, &config) == 0);
+
+    while (!atomic_load(&hello_started))
+        sched_yield();
+
+    message_t message = {.message_type = MSG_COUNT, .nbytes = 0, .data = NULL};
+    for (size_t i = 0; i < QUEUE_LIMIT_OVERRIDE; ++i)
+        CHECK(send_message_to(system, actor, message) == 0);
+    CHECK(send_message_to(system, actor, message) == -3);
+
+    CHECK(sem_post(&release_hello) == 0);
+    actor_system_wait(system);
+    CHECK(sem_destroy(&release_hello) == 0);
+
+    CHECK(counted == QUEUE_LIMIT_OVERRIDE);
+}
+
+static atomic_int hellos;
+
+static void counted_hello(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes,
+                          __attribute__((unused))void *data) {
+    atomic_fetch_add(&hellos, 1);
+    godie(actor_id_self());
+}
+
+static act_t counted_prompts[] = {counted_hello};
+static role_t counted_role = {.nprompts = 1, .prompts = counted_prompts};
+
+// Children run only after all spawns are handled, so the last one exceeds the cast limit
+// and is dropped.
+static void crowded_hello(__attribute__((unused))void **stateptr,
+                          __attribute__((unused))size_t nbytes,
+                          __attribute__((unused))void *data) {
+    for (size_t i = 0; i < CAST_LIMIT_OVERRIDE; ++i) {
+        CHECK(send_message(actor_id_self(), (message_t){.message_type = MSG_SPAWN,
+                                                        .nbytes = sizeof(role_t),
+                                                        .data = &counted_role}) == 0);
+    }
+    godie(actor_id_self());
+}
+
+static act_t crowded_prompts[] = {crowded_hello};
+static role_t crowded_role = {.nprompts = 1, .prompts = crowded_prompts};
+
+static void test_cast_limit() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+    config.cast_limit = CAST_LIMIT + 1;
+
+    actor_system_t *system;
+    actor_id_t actor;
+    CHECK(actor_system_start(&system, &actor, &crowded_role, &config) == -1);
+
+    config.cast_limit = CAST_LIMIT_OVERRIDE;
+    actor_system_wait(start(&crowded_role, &config));
+
+    CHECK(atomic_load(&hellos) == CAST_LIMIT_OVERRIDE - 1);
+}
+
+static size_t recycled;
+static size_t reused_slots;
+static actor_id_t last_child = -1;
+static role_t recycled_role;
+
+// Tells the parent its identifier and dies.
+static void recycled_hello(__attribute__((unused))void **stateptr,
+                           __attribute__((unused))size_t nbytes, void *data) {
+    CHECK(send_message((actor_id_t)data, (message_t){.message_type = MSG_CHILD, .nbytes = 0,
+                                                     .data = (void *)actor_id_self()}) == 0);
+    godie(actor_id_self());
+}
+
+static act_t recycled_prompts[] = {recycled_hello};
+static role_t recycled_role = {.nprompts = 1, .prompts = recycled_prompts};
+
+static void spawn_recycled() {
+    CHECK(send_message(actor_id_self(), (message_t){.message_type = MSG_SPAWN,
+                                                    .nbytes = sizeof(role_t),
+                                                    .data = &recycled_role}) == 0);
+}
+
+static void parent_hello(__attribute__((unused))void **stateptr,
+                         __attribute__((unused))size_t nbytes,
+                         __attribute__((unused))void *data) {
+    spawn_recycled();
+}
+
+// Children are spawned one after another, many more than the cast limit. A child in the
+// slot of the previous one has a new identifier, and the old one is no longer valid.
+static void parent_child(__attribute__((unused))void **stateptr,
+                         __attribute__((unused))size_t nbytes, void *data) {
+    actor_id_t child = (actor_id_t)data;
+
+    if (last_child >= 0 && (uint32_t)last_child == (uint32_t)child) {
+        CHECK(child != last_child);
+        CHECK(send_message(last_child, (message_t){.message_type = MSG_CHILD, .nbytes = 0,
+                                                   .data = NULL}) == -1);
+        ++reused_slots;
+    }
+    last_child = child;
+
+    if (++recycled < RECYCLED_CHILDREN)
+        spawn_recycled();
+    else
+        godie(actor_id_self());
+}
+
+static act_t parent_prompts[] = {parent_hello, parent_child};
+static role_t parent_role = {.nprompts = 2, .prompts = parent_prompts};
+
+static void test_recycling() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+    config.cast_limit = CAST_LIMIT_OVERRIDE;
+
+    actor_system_wait(start(&parent_role, &config));
+
+    CHECK(recycled == RECYCLED_CHILDREN);
+    CHECK(reused_slots > 0);
+}
+
+// Counts messages of its system and acknowledges each one to itself within the system.
+// Both fit in the queue together.
+static void counter_hello(void **stateptr, __attribute__((unused))size_t nbytes,
+                          __attribute__((unused))void *data) {
+    *stateptr = calloc(2, sizeof(size_t));
+    CHECK(*stateptr != NULL);
+}
+
+static void counter_count(void **stateptr, __attribute__((unused))size_t nbytes,
+                          __attribute__((unused))void *data) {
+    size_t *counts = *stateptr;
+
+    ++counts[0];
+    CHECK(send_message(actor_id_self(), (message_t){.message_type = MSG_ACK, .nbytes = 0,
+                                                    .data = NULL}) == 0);
+}
+
+static void counter_ack(void **stateptr, __attribute__((unused))size_t nbytes,
+                        __attribute__((unused))void *data) {
+    size_t *counts = *stateptr;
+
+    if (++counts[1] < SYSTEM_MESSAGES)
+        return;
+
+    CHECK(counts[0] == SYSTEM_MESSAGES);
+    free(counts);
+    *stateptr = NULL;
+    godie(actor_id_self());
+}
+
+static act_t counter_prompts[] = {counter_hello, counter_count, counter_ack};
+static role_t counter_role = {.nprompts = 3, .prompts = counter_prompts};
+
+static void test_systems() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+
+    actor_system_t *systems[SYSTEMS];
+    actor_id_t actors[SYSTEMS];
+    for (size_t i = 0; i < SYSTEMS; ++i)
+        CHECK(actor_system_start(&systems[i], &actors[i], &counter_role, &config) == 0);
+
+    message_t message = {.message_type = MSG_COUNT, .nbytes = 0, .data = NULL};
+    for (size_t k = 0; k < SYSTEM_MESSAGES; ++k) {
+        for (size_t i = 0; i < SYSTEMS; ++i) {
+            int err;
+            while ((err = send_message_to(systems[i], actors[i], message)) == -3)
+                sched_yield();
+            CHECK(err == 0);
+        }
+    }
+
+    for (size_t i = 0; i < SYSTEMS; ++i)
+        actor_system_wait(systems[i]);
+}
+
+int main() {
+    test_queue_limit();
+    test_cast_limit();
+    test_recycling();
+    test_systems();
+    return 0;
+}
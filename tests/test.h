@@ -0,0 +1,16 @@
+#ifndef CACTI_TEST_H
+#define CACTI_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Ends the test with a failure if [condition] does not hold. Works in handlers as well.
+#define CHECK(condition)                                                                \
+    do {                                                                                \
+        if (!(condition)) {                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+#endif //CACTI_TEST_H
@@ -0,0 +1,123 @@
+#include <stdatomic.h>
+#include <time.h>
+
+#include "cacti.h"
+#include "test.h"
+
+// Timers send their messages after their delays, periodic ones until they are cancelled,
+// and each timer can be cancelled only once.
+
+#define MSG_TICK 1
+
+#define WAIT_MS 5000
+
+static atomic_ulong ticks;
+
+static void tick(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+                 __attribute__((unused))void *data) {
+    atomic_fetch_add(&ticks, 1);
+}
+
+static void nothing(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+                    __attribute__((unused))void *data) {
+}
+
+static act_t prompts[] = {nothing, tick};
+static role_t role = {.nprompts = 2, .prompts = prompts};
+
+static const message_t tick_message = {.message_type = MSG_TICK, .nbytes = 0, .data = NULL};
+
+static unsigned long long now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000 + (unsigned long long)now.tv_nsec / 1000000;
+}
+
+static void sleep_ms(unsigned long ms) {
+    struct timespec duration = {.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000};
+    nanosleep(&duration, NULL);
+}
+
+// Waits until [ticks] reaches [count], or WAIT_MS passes.
+static void wait_for_ticks(unsigned long count) {
+    for (unsigned long ms = 0; atomic_load(&ticks) < count && ms < WAIT_MS; ++ms)
+        sleep_ms(1);
+}
+
+static void test_after(actor_system_t *system, actor_id_t actor) {
+    actor_timer_t timer;
+    atomic_store(&ticks, 0);
+
+    unsigned long long start = now_ms();
+    CHECK(send_message_after_to(system, actor, tick_message, 20, &timer) == 0);
+    wait_for_ticks(1);
+
+    CHECK(atomic_load(&ticks) == 1);
+    CHECK(now_ms() - start >= 20);
+    // The timer has sent its only message.
+    CHECK(actor_timer_cancel_to(system, timer) == -1);
+}
+
+static void test_cancel_twice(actor_system_t *system, actor_id_t actor) {
+    actor_timer_t first, second;
+    atomic_store(&ticks, 0);
+
+    CHECK(send_message_after_to(system, actor, tick_message, 10, &first) == 0);
+    CHECK(actor_timer_cancel_to(system, first) == 0);
+    CHECK(actor_timer_cancel_to(system, first) == -1);
+
+    // The second timer may take the slot of the first one, which must not cancel it.
+    CHECK(send_message_after_to(system, actor, tick_message, 10, &second) == 0);
+    CHECK(actor_timer_cancel_to(system, first) == -1);
+    wait_for_ticks(1);
+
+    CHECK(atomic_load(&ticks) == 1);
+    CHECK(actor_timer_cancel_to(system, second) == -1);
+}
+
+static void test_periodic(actor_system_t *system, actor_id_t actor) {
+    actor_timer_t timer;
+    atomic_store(&ticks, 0);
+
+    CHECK(send_message_every_to(system, actor, tick_message, 2, &timer) == 0);
+    wait_for_ticks(5);
+    CHECK(atomic_load(&ticks) >= 5);
+
+    CHECK(actor_timer_cancel_to(system, timer) == 0);
+    // Messages sent before the cancellation are still handled.
+    sleep_ms(20);
+    unsigned long cancelled = atomic_load(&ticks);
+    sleep_ms(50);
+
+    CHECK(atomic_load(&ticks) == cancelled);
+    CHECK(actor_timer_cancel_to(system, timer) == -1);
+}
+
+static void test_invalid(actor_system_t *system, actor_id_t actor) {
+    CHECK(send_message_every_to(system, actor, tick_message, 0, NULL) == -1);
+    CHECK(send_message_after_to(system, actor + 1, tick_message, 10, NULL) == -2);
+    CHECK(actor_timer_cancel_to(system, -1) == -1);
+}
+
+int main() {
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 2;
+
+    actor_system_t *system;
+    actor_id_t actor;
+    CHECK(actor_system_start(&system, &actor, &role, &config) == 0);
+
+    test_after(system, actor);
+    test_cancel_twice(system, actor);
+    test_periodic(system, actor);
+    test_invalid(system, actor);
+
+    // A periodic timer of a dead actor must not keep the system alive.
+    CHECK(send_message_every_to(system, actor, tick_message, 1, NULL) == 0);
+    CHECK(send_message_to(system, actor, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                                     .data = NULL}) == 0);
+    actor_system_wait(system);
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include <ctype.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "test.h"
+
+// Traces are valid JSON with an event per handler execution, written on demand and when
+// the system finishes, if the library keeps events at all.
+
+#define MSG_WORK 1
+#define MSG_SYNC 2
+
+#define MESSAGES 100
+
+#ifdef CACTI_TRACE
+static const bool tracing = true;
+#else
+static const bool tracing = false;
+#endif
+
+static atomic_bool synced;
+
+static void nothing(__attribute__((unused))void **stateptr, __attribute__((unused))size_t nbytes,
+                    __attribute__((unused))void *data) {
+}
+
+// Handlers of all earlier messages have ended, so their events are recorded.
+static void synchronize(__attribute__((unused))void **stateptr,
+                        __attribute__((unused))size_t nbytes, __attribute__((unused))void *data) {
+    atomic_store(&synced, true);
+}
+
+static act_t prompts[] = {nothing, nothing, synchronize};
+static role_t role = {.nprompts = 3, .prompts = prompts};
+
+static const char *skip_spaces(const char *text) {
+    while (isspace((unsigned char)*text))
+        ++text;
+    return text;
+}
+
+static const char *parse_value(const char *text);
+
+// Each parse_ function returns the end of the value at [text], or NULL if it is not valid.
+static const char *parse_string(const char *text) {
+    if (*text++ != '"')
+        return NULL;
+
+    for (; *text != '"'; ++text) {
+        if ((unsigned char)*text < 0x20)
+            return NULL;
+        if (*text == '\\' && (*++text == '\0' || strchr("\"\\/bfnrtu", *text) == NULL))
+            return NULL;
+    }
+    return text + 1;
+}
+
+static const char *parse_number(const char *text) {
+    const char *start = text;
+
+    if (*text == '-')
+        ++text;
+    if (!isdigit((unsigned char)*text))
+        return NULL;
+    // Leading zeros are not allowed.
+    if (*text == '0' && isdigit((unsigned char)text[1]))
+        return NULL;
+    while (isdigit((unsigned char)*text))
+        ++text;
+
+    if (*text == '.') {
+        if (!isdigit((unsigned char)*++text))
+            return NULL;
+        while (isdigit((unsigned char)*text))
+            ++text;
+    }
+    if (*text == 'e' || *text == 'E') {
+        if (*++text == '+' || *text == '-')
+            ++text;
+        if (!isdigit((unsigned char)*text))
+            return NULL;
+        while (isdigit((unsigned char)*text))
+            ++text;
+    }
+    return text > start ? text : NULL;
+}
+
+// Parses elements of an array, or members of an object if [object] is true.
+static const char *parse_elements(const char *text, bool object) {
+    char close = object ? '}' : ']';
+
+    text = skip_spaces(text + 1);
+    if (*text == close)
+        return text + 1;
+
+    while (true) {
+        if (object) {
+            if ((text = parse_string(text)) == NULL)
+                return NULL;
+            text = skip_spaces(text);
+            if (*text++ != ':')
+                return NULL;
+        }
+        if ((text = parse_value(text)) == NULL)
+            return NULL;
+
+        text = skip_spaces(text);
+        if (*text == close)
+            return text + 1;
+        if (*text++ != ',')
+            return NULL;
+        text = skip_spaces(text);
+    }
+}
+
+static const char *parse_value(const char *text) {
+    text = skip_spaces(text);
+
+    switch (*text) {
+        case '{':
+            return parse_elements(text, true);
+        case '[':
+            return parse_elements(text, false);
+        case '"':
+            return parse_string(text);
+        case 't':
+            return strncmp(text, "true", 4) == 0 ? text + 4 : NULL;
+        case 'f':
+            return strncmp(text, "false", 5) == 0 ? text + 5 : NULL;
+        case 'n':
+            return strncmp(text, "null", 4) == 0 ? text + 4 : NULL;
+        default:
+            return parse_number(text);
+    }
+}
+
+static size_t count_occurrences(const char *text, const char *pattern) {
+    size_t count = 0;
+    for (text = strstr(text, pattern); text != NULL; text = strstr(text + 1, pattern))
+        ++count;
+    return count;
+}
+
+// Checks that [path] holds a single JSON object with beginnings and ends of [MESSAGES]
+// handler executions.
+static void check_trace(const char *path) {
+    FILE *file = fopen(path, "r");
+    CHECK(file != NULL);
+    CHECK(fseek(file, 0, SEEK_END) == 0);
+    long size = ftell(file);
+    CHECK(size > 0);
+    rewind(file);
+
+    char *text = malloc((size_t)size + 1);
+    CHECK(text != NULL);
+    CHECK(fread(text, 1, (size_t)size, file) == (size_t)size);
+    text[size] = '\0';
+    fclose(file);
+
+    const char *end = parse_value(text);
+    CHECK(end != NULL);
+    CHECK(*skip_spaces(end) == '\0');
+    CHECK(*skip_spaces(text) == '{');
+
+    CHECK(strstr(text, "\"traceEvents\":[") != NULL);
+    CHECK(count_occurrences(text, "\"ph\":\"B\",\"name\":\"message 1\"") == MESSAGES);
+    CHECK(count_occurrences(text, "\"ph\":\"E\",\"name\":\"message 1\"") == MESSAGES);
+
+    free(text);
+}
+
+int main() {
+    char written[] = "/tmp/cacti_trace_XXXXXX";
+    char finished[] = "/tmp/cacti_trace_XXXXXX";
+    int fd;
+    CHECK((fd = mkstemp(written)) >= 0 && close(fd) == 0);
+    CHECK((fd = mkstemp(finished)) >= 0 && close(fd) == 0);
+
+    actor_system_config_t config;
+    actor_system_config_init(&config);
+    config.pool_size = 1;
+    config.trace_file = finished;
+
+    actor_system_t *system;
+    actor_id_t actor;
+    CHECK(actor_system_start(&system, &actor, &role, &config) == 0);
+
+    for (size_t i = 0; i < MESSAGES; ++i) {
+        CHECK(send_message_to(system, actor, (message_t){.message_type = MSG_WORK, .nbytes = 0,
+                                                         .data = NULL}) == 0);
+    }
+
+    CHECK(send_message_to(system, actor, (message_t){.message_type = MSG_SYNC, .nbytes = 0,
+                                                     .data = NULL}) == 0);
+
+    struct timespec millisecond = {.tv_sec = 0, .tv_nsec = 1000000};
+    for (int ms = 0; !atomic_load(&synced) && ms < 5000; ++ms)
+        nanosleep(&millisecond, NULL);
+    CHECK(atomic_load(&synced));
+
+    CHECK(actor_system_trace_write(system, written) == (tracing ? 0 : -1));
+    if (tracing)
+        check_trace(written);
+
+    CHECK(send_message_to(system, actor, (message_t){.message_type = MSG_GODIE, .nbytes = 0,
+                                                     .data = NULL}) == 0);
+    actor_system_wait(system);
+
+    if (tracing)
+        check_trace(finished);
+
+    CHECK(unlink(written) == 0);
+    CHECK(unlink(finished) == 0);
+    return 0;
+}
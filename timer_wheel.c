@@ -0,0 +1,155 @@
+#include "timer_wheel.h"
+
+static void link_timer(wheel_timer_t *head, wheel_timer_t *timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static void unlink_timer(wheel_timer_t *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+}
+
+// Puts [timer] into the slot of the lowest level which reaches its expiry.
+static void place_timer(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    unsigned long long expires = timer->expires;
+    if (expires <= wheel->now)
+        expires = wheel->now + 1;
+
+    unsigned long long delta = expires - wheel->now;
+    size_t level = 0;
+    while (level + 1 < TIMER_WHEEL_LEVELS &&
+           delta >= 1ULL << (TIMER_WHEEL_BITS * (level + 1)))
+        ++level;
+
+    // Further timers go back to the wheel from the last slot the top level reaches.
+    if (delta >= 1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+        expires = wheel->now + (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+    size_t slot = (size_t)(expires >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+    link_timer(&wheel->slots[level][slot], timer);
+}
+
+void create_timer_wheel(timer_wheel_t *wheel, unsigned long long now) {
+    wheel->now = now;
+    wheel->count = 0;
+
+    for (size_t level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        for (size_t slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+            wheel->slots[level][slot].next = &wheel->slots[level][slot];
+            wheel->slots[level][slot].prev = &wheel->slots[level][slot];
+        }
+    }
+}
+
+bool timer_wheel_empty(const timer_wheel_t *wheel) {
+    return wheel->count == 0;
+}
+
+void timer_wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    place_timer(wheel, timer);
+    ++wheel->count;
+}
+
+void timer_wheel_remove(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    unlink_timer(timer);
+    --wheel->count;
+}
+
+// Moves timers of the current slot of [level] to lower levels.
+static void cascade(timer_wheel_t *wheel, size_t level) {
+    size_t slot = (size_t)(wheel->now >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+    wheel_timer_t *head = &wheel->slots[level][slot];
+    wheel_timer_t *timer = head->next;
+
+    head->next = head;
+    head->prev = head;
+
+    while (timer != head) {
+        wheel_timer_t *next = timer->next;
+
+        // Slot of the current tick is processed after cascading.
+        if (timer->expires <= wheel->now)
+            link_timer(&wheel->slots[0][wheel->now & (TIMER_WHEEL_SLOTS - 1)], timer);
+        else
+            place_timer(wheel, timer);
+
+        timer = next;
+    }
+}
+
+unsigned long long timer_wheel_next(const timer_wheel_t *wheel) {
+    unsigned long long next = ~0ULL;
+
+    // Slot of a level comes again after a full turn of the level, so its current slot is
+    // the furthest one.
+    for (size_t level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        unsigned long long turn = wheel->now >> (TIMER_WHEEL_BITS * level);
+
+        for (size_t slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+            if (wheel->slots[level][slot].next == &wheel->slots[level][slot])
+                continue;
+
+            size_t distance = (slot - (size_t)turn) & (TIMER_WHEEL_SLOTS - 1);
+            if (distance == 0)
+                distance = TIMER_WHEEL_SLOTS;
+
+            unsigned long long tick = (turn + distance) << (TIMER_WHEEL_BITS * level);
+            if (tick < next)
+                next = tick;
+        }
+    }
+
+    return next;
+}
+
+wheel_timer_t *timer_wheel_advance(timer_wheel_t *wheel, unsigned long long now) {
+    // Expired timers are returned in order of adding.
+    wheel_timer_t *expired = NULL;
+    wheel_timer_t **expired_end = &expired;
+
+    while (wheel->now < now) {
+        unsigned long long next = wheel->count > 0 ? timer_wheel_next(wheel) : now + 1;
+        if (next > now) {
+            wheel->now = now;
+            break;
+        }
+
+        wheel->now = next;
+
+        // Slots of higher levels whose turn has come are emptied from the top, so their
+        // timers may fall through several levels at once.
+        size_t levels = 1;
+        while (levels < TIMER_WHEEL_LEVELS &&
+               (wheel->now & ((1ULL << (TIMER_WHEEL_BITS * levels)) - 1)) == 0)
+            ++levels;
+        for (size_t level = levels - 1; level > 0; --level)
+            cascade(wheel, level);
+
+        wheel_timer_t *head = &wheel->slots[0][wheel->now & (TIMER_WHEEL_SLOTS - 1)];
+        wheel_timer_t *timer = head->next;
+
+        head->next = head;
+        head->prev = head;
+
+        while (timer != head) {
+            wheel_timer_t *next = timer->next;
+
+            if (timer->expires <= wheel->now) {
+                *expired_end = timer;
+                expired_end = &timer->next;
+                --wheel->count;
+            }
+            else {
+                place_timer(wheel, timer);
+            }
+
+            timer = next;
+        }
+    }
+
+    *expired_end = NULL;
+    return expired;
+}
@@ -0,0 +1,45 @@
+#ifndef CACTI_TIMER_WHEEL_H
+#define CACTI_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Level l has TIMER_WHEEL_SLOTS slots of TIMER_WHEEL_SLOTS^l ticks each. Timers further
+// in the future than the last level reaches wait in its furthest slot.
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+// Intrusive timer node. [expires] is the tick at which the timer fires.
+typedef struct wheel_timer {
+    struct wheel_timer *next;
+    struct wheel_timer *prev;
+    unsigned long long expires;
+} wheel_timer_t;
+
+// Hierarchical timing wheel. Adding and removing a timer take constant time, timers are
+// moved to lower levels when their slot's turn comes.
+typedef struct timer_wheel {
+    unsigned long long now;     // Last tick processed.
+    size_t count;
+    wheel_timer_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];     // List heads.
+} timer_wheel_t;
+
+void create_timer_wheel(timer_wheel_t *wheel, unsigned long long now);
+
+bool timer_wheel_empty(const timer_wheel_t *wheel);
+
+// Adds [timer], whose [expires] is set. Timers which expire before the next tick fire in it.
+void timer_wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer);
+
+void timer_wheel_remove(timer_wheel_t *wheel, wheel_timer_t *timer);
+
+// Returns the first tick after the last processed one at which some timer expires or is
+// moved to a lower level. Wheel must not be empty.
+unsigned long long timer_wheel_next(const timer_wheel_t *wheel);
+
+// Processes ticks up to [now] and returns timers which expired, removed from the wheel and
+// linked by their [next] fields. Ticks at which nothing happens are skipped.
+wheel_timer_t *timer_wheel_advance(timer_wheel_t *wheel, unsigned long long now);
+
+#endif //CACTI_TIMER_WHEEL_H